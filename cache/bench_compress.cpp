@@ -0,0 +1,63 @@
+#include "block_compressor.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Measures BlockCompressor scaling, compressed output is verified against
+// serial compression for every thread count
+int main() {
+  constexpr size_t BLOCK_SIZE = 0x40000;
+  constexpr size_t NUM_BLOCKS = 64;
+  std::mt19937 rng(0x1234);
+  std::vector<std::string> blocks(NUM_BLOCKS);
+
+  // Half compressible data, similar to packed vertex buffers and scripts
+  for (auto &b : blocks) {
+    b.resize(BLOCK_SIZE);
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+      b[i] = (i & 1) ? char(rng() & 0xf) : char(i >> 4);
+    }
+  }
+
+  std::string serial;
+  for (auto &b : blocks) {
+    serial.append(BlockCompressor::Compress(b, ZSTD_btultra));
+  }
+
+  const size_t maxThreads = std::thread::hardware_concurrency();
+  double baseTime = 0;
+
+  for (size_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+    prime::utils::ThreadPool pool(numThreads);
+    std::string output;
+    BlockCompressor compressor(
+        pool, [&](const std::string &compressed, uint32_t) {
+          output.append(compressed);
+        });
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    for (auto &b : blocks) {
+      compressor.Send(std::string(b));
+    }
+
+    compressor.Flush();
+    auto dur = std::chrono::high_resolution_clock::now() - startTime;
+    const double millis =
+        std::chrono::duration_cast<std::chrono::microseconds>(dur).count() /
+        1000.0;
+
+    if (numThreads == 1) {
+      baseTime = millis;
+    }
+
+    printf("[%2zu threads] %8.2f ms, %5.2fx, %s\n", numThreads, millis,
+           baseTime / millis, output == serial ? "identical" : "MISMATCH");
+
+    if (output != serial) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
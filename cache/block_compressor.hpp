@@ -0,0 +1,95 @@
+#pragma once
+#include "utils/thread_pool.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <zstd.h>
+
+// Compresses blocks on worker pool, each worker owns a single ZSTD_CCtx
+// Results are handed to onBlock in submission order, output is identical to
+// compressing blocks serially
+struct BlockCompressor {
+  using BlockFunc =
+      std::function<void(const std::string &compressed, uint32_t dictionary)>;
+
+  BlockCompressor(prime::utils::ThreadPool &pool_, BlockFunc onBlock_,
+                  int level_ = ZSTD_btultra)
+      : pool(pool_), onBlock(std::move(onBlock_)), level(level_),
+        maxPending(pool_.NumThreads() * 2) {}
+
+  // dictionary is passed to onBlock as is, cdict must outlive Flush
+  void Send(std::string &&block, uint32_t dictionary = 0,
+            const ZSTD_CDict *cdict = nullptr) {
+    if (pending.size() >= maxPending) {
+      onBlock(pending.front().result.get(), pending.front().dictionary);
+      pending.pop_front();
+    }
+
+    pending.emplace_back(Job{
+        pool.Enqueue([block = std::move(block), level = level, cdict] {
+          return Compress(block, level, cdict);
+        }),
+        dictionary,
+    });
+  }
+
+  // Already compressed block, keeps its place in output order
+  void SendCompressed(std::string &&compressed, uint32_t dictionary = 0) {
+    if (pending.size() >= maxPending) {
+      onBlock(pending.front().result.get(), pending.front().dictionary);
+      pending.pop_front();
+    }
+
+    std::promise<std::string> ready;
+    ready.set_value(std::move(compressed));
+    pending.emplace_back(Job{ready.get_future(), dictionary});
+  }
+
+  void Flush() {
+    for (auto &p : pending) {
+      onBlock(p.result.get(), p.dictionary);
+    }
+
+    pending.clear();
+  }
+
+  static std::string Compress(const std::string &block, int level,
+                              const ZSTD_CDict *cdict = nullptr) {
+    struct CCtxDeleter {
+      void operator()(ZSTD_CCtx *ctx) const { ZSTD_freeCCtx(ctx); }
+    };
+
+    thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> zctx(
+        ZSTD_createCCtx());
+    std::string retVal;
+    retVal.resize(ZSTD_compressBound(block.size()));
+    const size_t cSize =
+        cdict ? ZSTD_compress_usingCDict(zctx.get(), retVal.data(),
+                                         retVal.size(), block.data(),
+                                         block.size(), cdict)
+              : ZSTD_compressCCtx(zctx.get(), retVal.data(), retVal.size(),
+                                  block.data(), block.size(), level);
+
+    if (ZSTD_isError(cSize)) {
+      throw std::runtime_error(std::string("Block compression failed: ") +
+                               ZSTD_getErrorName(cSize));
+    }
+
+    retVal.resize(cSize);
+    return retVal;
+  }
+
+private:
+  struct Job {
+    std::future<std::string> result;
+    uint32_t dictionary;
+  };
+
+  prime::utils::ThreadPool &pool;
+  BlockFunc onBlock;
+  int level;
+  size_t maxPending;
+  std::deque<Job> pending;
+};
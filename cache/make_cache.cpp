@@ -15,7 +15,9 @@
     along with this program.If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include "common/array.hpp"
+#include "block_compressor.hpp"
+#include "strippers.hpp"
+#include "common/cache.hpp"
 #include "common/core.hpp"
 #include "common/resource.hpp"
 #include "project.h"
@@ -24,20 +26,42 @@
 #include "spike/io/binreader.hpp"
 #include "spike/io/binwritter.hpp"
 #include "spike/io/stat.hpp"
+#include "spike/master_printer.hpp"
+#include "spike/reflect/reflector.hpp"
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
-#include <zstd.h>
+#include <sys/stat.h>
+#include <zdict.h>
+
+struct MakeCache : ReflectorBase<MakeCache> {
+  bool incremental = false;
+  bool stripDebug = false;
+} settings;
+
+REFLECT(CLASS(MakeCache),
+        MEMBERNAME(incremental, "incremental", "i",
+                   ReflDesc{"Reuse unchanged blocks of previously built "
+                            "cache instead of recompressing them. Files keep "
+                            "their place within block, so changed file costs "
+                            "up to one block of padding."}),
+        MEMBERNAME(stripDebug, "strip-debug", "s",
+                   ReflDesc{"Move debug data of resources into separate "
+                            ".debug cache, main cache holds only runtime "
+                            "data."}), )
 
 static AppInfo_s appInfo{
     .header = PrimeCache_DESC " v" PrimeCache_VERSION ", " PrimeCache_COPYRIGHT
                               "Lukas Cone",
+    .settings = reinterpret_cast<ReflectorFriend *>(&settings),
 };
 
 AppInfo_s *AppInitModule() { return &appInfo; }
 
-extern std::map<uint32, std::string (*)(BinReaderRef)> STRIPPERS;
-
 struct SubStream {
   size_t offset;
   uint32 size;
@@ -46,23 +70,23 @@ struct SubStream {
 struct Stream {
   std::string streamPath;
   BinWritter_t<BinCoreOpenMode::NoBuffer> streamStore;
+  // Uncompressed offset of stream within .dat
   size_t blobalOffset = 0;
   std::mutex mtx;
 
   Stream(std::string &&path)
       : streamPath(std::move(path)), streamStore(streamPath) {}
 
-  SubStream SendStream(std::istream &str, uint32 clHash) {
-    if (STRIPPERS.contains(clHash)) {
-      auto stripped = STRIPPERS.at(clHash)(str);
-      std::lock_guard lg(mtx);
-      SubStream retVal;
-      retVal.offset = streamStore.Tell();
-      retVal.size = stripped.size();
-      streamStore.WriteContainer(stripped);
-      return retVal;
-    }
+  SubStream SendBuffer(const std::string &data) {
+    std::lock_guard lg(mtx);
+    SubStream retVal;
+    retVal.offset = streamStore.Tell();
+    retVal.size = data.size();
+    streamStore.WriteContainer(data);
+    return retVal;
+  }
 
+  SubStream SendStream(std::istream &str) {
     std::lock_guard lg(mtx);
     const size_t inputSize = BinReaderRef(str).GetSize();
     char buffer[0x10000];
@@ -94,38 +118,162 @@ struct IFile {
   bool operator<(const IFile &o) const { return info < o.info; }
 };
 
-namespace prime::common {
-struct CacheFile;
-struct CacheBlock;
-struct Cache;
-} // namespace prime::common
-
-HASH_CLASS(prime::common::CacheFile);
-HASH_CLASS(prime::common::CacheBlock);
-CLASS_EXT(prime::common::Cache);
+struct DDictDeleter {
+  void operator()(ZSTD_DDict *dict) const { ZSTD_freeDDict(dict); }
+};
 
-namespace prime::common {
-struct CacheFile {
-  prime::common::ResourceHash info;
-  uint64 blockOffset : 20; // 255GiB
-  uint64 microOffset : 18; // BLOCK_SIZE
-  uint64 tailSize : 18;    // BLOCK_SIZE
-  uint64 numBlocks : 8;    // 64MiB
+struct DCtxDeleter {
+  void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); }
 };
 
-static_assert(sizeof(CacheFile) == 16);
+// Cache made by previous run, blocks are looked up by class dictionary and
+// crc of decompressed data
+// Previous files are kept as .prev until new cache is written, failed build
+// puts them back
+struct PreviousCache {
+  std::string outIndexPath;
+  std::string outDataPath;
+  std::string indexPath;
+  std::string dataPath;
+  std::string index;
+  BinReader data;
+  std::map<std::pair<uint32, uint32>, const prime::common::CacheBlock *> blocks;
+  std::map<uint32, std::string> dictionaries;
+  // Position of file within its first block
+  std::map<prime::common::ResourceHash, uint32> microOffsets;
+  std::map<uint32, std::unique_ptr<ZSTD_DDict, DDictDeleter>> ddicts;
+  std::unique_ptr<ZSTD_DCtx, DCtxDeleter> dctx{ZSTD_createDCtx()};
+  bool committed = false;
+
+  static bool FileExists(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+  }
 
-struct CacheBlock {
-  uint64 offset;
-  uint32 size;
-  uint32 crc;
-};
+  bool Load(const std::string &indexPath_, const std::string &dataPath_) {
+    namespace pc = prime::common;
+    outIndexPath = indexPath_;
+    outDataPath = dataPath_;
+    indexPath = indexPath_ + ".prev";
+    dataPath = dataPath_ + ".prev";
+
+    // Left by killed build, outputs next to them are incomplete
+    if (FileExists(indexPath) && FileExists(dataPath)) {
+      PrintWarning("Using previous cache left by interrupted build.");
+    } else if (std::rename(indexPath_.c_str(), indexPath.c_str())) {
+      // Output files are about to be truncated
+      PrintWarning("Previous cache not found, building from scratch.");
+      indexPath.clear();
+      return false;
+    } else if (std::rename(dataPath_.c_str(), dataPath.c_str())) {
+      std::rename(indexPath.c_str(), indexPath_.c_str());
+      PrintWarning("Previous cache not found, building from scratch.");
+      indexPath.clear();
+      return false;
+    }
+
+    BinReader idx(indexPath);
+    idx.ReadContainer(index, idx.GetSize());
+    const pc::Cache *hdr = reinterpret_cast<const pc::Cache *>(index.data());
+
+    if (index.size() < sizeof(pc::Cache) || pc::ValidateClass(*hdr)) {
+      PrintWarning("Previous cache is invalid, building from scratch.");
+      return false;
+    }
+
+    data.Open(dataPath);
+
+    for (auto &d : hdr->dictionaries) {
+      dictionaries.emplace(d.classHash,
+                           std::string(d.data.begin(), d.data.end()));
+    }
+
+    for (auto &b : hdr->blocks) {
+      if (b.dictionary > hdr->dictionaries.numItems) {
+        continue;
+      }
+
+      const uint32 clHash =
+          b.dictionary ? hdr->dictionaries[b.dictionary - 1].classHash : 0;
+      blocks.emplace(std::make_pair(clHash, b.rawCrc), &b);
+    }
+
+    for (auto &f : hdr->files) {
+      microOffsets.emplace(f.info, f.microOffset);
+    }
+
+    return true;
+  }
+
+  const ZSTD_DDict *DDict(uint32 dictClass) {
+    if (dictClass == 0) {
+      return nullptr;
+    }
+
+    auto &ddict = ddicts[dictClass];
+
+    if (!ddict) {
+      const std::string &dict = dictionaries.at(dictClass);
+      ddict.reset(ZSTD_createDDict(dict.data(), dict.size()));
+    }
+
+    return ddict.get();
+  }
 
-struct Cache : Resource<Cache> {
-  LocalArray32<CacheFile> files;
-  LocalArray32<CacheBlock> blocks;
+  // Returns compressed data if block with same contents exists
+  std::string Find(uint32 dictClass, const std::string &block) {
+    const uint32 rawCrc = crc32b(0, block.data(), block.size());
+    auto found = blocks.find({dictClass, rawCrc});
+
+    if (found == blocks.end()) {
+      return {};
+    }
+
+    std::string compressed;
+    data.Seek(found->second->offset);
+    data.ReadContainer(compressed, found->second->size);
+
+    if (crc32b(0, compressed.data(), compressed.size()) !=
+            found->second->crc ||
+        ZSTD_getFrameContentSize(compressed.data(), compressed.size()) !=
+            block.size()) {
+      return {};
+    }
+
+    // rawCrc only narrows candidates, different blocks can share it
+    std::string decompressed;
+    decompressed.resize(block.size());
+    const size_t dSize = ZSTD_decompress_usingDDict(
+        dctx.get(), decompressed.data(), decompressed.size(),
+        compressed.data(), compressed.size(), DDict(dictClass));
+
+    if (ZSTD_isError(dSize) || dSize != block.size() ||
+        memcmp(decompressed.data(), block.data(), block.size())) {
+      return {};
+    }
+
+    return compressed;
+  }
+
+  // New cache is complete, previous one can go
+  void Commit() { committed = true; }
+
+  ~PreviousCache() {
+    if (indexPath.empty()) {
+      return;
+    }
+
+    es::Dispose(data);
+
+    if (committed) {
+      std::remove(indexPath.c_str());
+      std::remove(dataPath.c_str());
+    } else {
+      std::rename(indexPath.c_str(), outIndexPath.c_str());
+      std::rename(dataPath.c_str(), outDataPath.c_str());
+    }
+  }
 };
-} // namespace prime::common
 
 struct MakeContext : AppPackContext {
   std::string baseFile;
@@ -133,8 +281,36 @@ struct MakeContext : AppPackContext {
   std::mutex mtx;
   std::vector<IFile> files;
   std::set<std::string> fileNames;
+  // Receives stripped debug data, same layout as main cache
+  std::unique_ptr<MakeContext> debugSidecar;
+  bool isSidecar = false;
+
+  MakeContext(std::string baseFile_, bool isSidecar_ = false)
+      : baseFile(std::move(baseFile_)), isSidecar(isSidecar_) {
+    if (settings.stripDebug && !isSidecar) {
+      debugSidecar = std::make_unique<MakeContext>(baseFile + ".debug", true);
+    }
+  }
+
+  template <class SendFunc>
+  void AddFile(std::string_view name, std::string_view ext, uint32 clHash,
+               SendFunc &&send) {
+    if (!streams.contains(clHash)) {
+      std::lock_guard lg(mtx);
+      streams.emplace(clHash, baseFile + std::string(ext));
+    }
+
+    IFile curFile;
+    curFile.info.type = clHash;
+    curFile.info.name = JenkinsHash3_(name);
+    curFile.location = send(streams.at(clHash));
 
-  MakeContext(std::string baseFile_) : baseFile(std::move(baseFile_)) {}
+    {
+      std::lock_guard lg(mtx);
+      files.emplace_back(curFile);
+      fileNames.emplace(name);
+    }
+  }
 
   void SendFile(std::string_view path, std::istream &stream) override {
     auto dot = path.find_last_of('.');
@@ -152,27 +328,78 @@ struct MakeContext : AppPackContext {
 
     clHash = prime::common::GetClassFromExtension(ext).ValueOr(
         [] { throw std::runtime_error("File not supported."); });
+    const std::string_view name = path.substr(0, dot);
 
-    if (!streams.contains(clHash)) {
-      std::lock_guard lg(mtx);
-      streams.emplace(clHash, baseFile + std::string(ext));
+    if (!debugSidecar) {
+      AddFile(name, ext, clHash,
+              [&](Stream &str) { return str.SendStream(stream); });
+      return;
     }
 
-    IFile curFile;
-    curFile.info.type = clHash;
-    curFile.info.name = JenkinsHash3_(path.substr(0, dot));
-    curFile.location = streams.at(clHash).SendStream(stream, clHash);
+    StrippedResource stripped = StripResourceDebug(stream);
+    AddFile(name, ext, clHash,
+            [&](Stream &str) { return str.SendBuffer(stripped.payload); });
 
-    {
-      std::lock_guard lg(mtx);
-      files.emplace_back(curFile);
-      fileNames.emplace(path.substr(0, dot));
+    if (!stripped.debug.empty()) {
+      const prime::common::CacheDebugTrailer trailer{
+          .payloadCrc = crc32b(0, stripped.payload.data(),
+                               stripped.payload.size()),
+      };
+      stripped.debug.append(reinterpret_cast<const char *>(&trailer),
+                            sizeof(trailer));
+      debugSidecar->AddFile(name, ext, clHash, [&](Stream &str) {
+        return str.SendBuffer(stripped.debug);
+      });
+    }
+  }
+
+  // Train dictionary from resources small enough to benefit from it
+  static std::string TrainDictionary(BinReaderRef rd,
+                                     const std::vector<IFile *> &clFiles) {
+    constexpr size_t MAX_SAMPLE_SIZE = 0x10000;
+    constexpr size_t MAX_SAMPLES_SIZE = 0x1000000;
+    constexpr size_t MIN_SAMPLES = 8;
+    std::string samples;
+    std::vector<size_t> sampleSizes;
+
+    for (IFile *f : clFiles) {
+      if (f->location.size > MAX_SAMPLE_SIZE || f->location.size == 0) {
+        continue;
+      }
+
+      if (samples.size() + f->location.size > MAX_SAMPLES_SIZE) {
+        break;
+      }
+
+      const size_t sampleBegin = samples.size();
+      samples.resize(sampleBegin + f->location.size);
+      rd.Seek(f->location.offset);
+      rd.ReadBuffer(samples.data() + sampleBegin, f->location.size);
+      sampleSizes.push_back(f->location.size);
+    }
+
+    if (sampleSizes.size() < MIN_SAMPLES) {
+      return {};
+    }
+
+    std::string dict;
+    dict.resize(std::min(size_t(112640), samples.size() / 8));
+    const size_t dictSize =
+        ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data(),
+                              sampleSizes.data(), sampleSizes.size());
+
+    if (ZDICT_isError(dictSize)) {
+      return {};
     }
+
+    dict.resize(dictSize);
+    return dict;
   }
 
   void Finish() override {
     namespace pc = prime::common;
-    {
+
+    if (!isSidecar) {
       BinWritter refs(baseFile + ".refs");
       for (auto &f : fileNames) {
         refs.WriteContainer(f);
@@ -180,10 +407,22 @@ struct MakeContext : AppPackContext {
       }
     }
 
-    BinWritter outIdx(baseFile + "." +
-                      std::string(pc::GetClassExtension<pc::Cache>()));
-    BinWritter_t<BinCoreOpenMode::NoBuffer> outData(baseFile + ".dat");
+    const std::string indexPath =
+        baseFile + "." + std::string(pc::GetClassExtension<pc::Cache>());
+    const std::string dataPath = baseFile + ".dat";
+    PreviousCache prevCache;
+    const bool incremental =
+        settings.incremental && prevCache.Load(indexPath, dataPath);
+
+    // Replaced by rename once complete, mounted archive keeps its mapping
+    BinWritter outIdx(indexPath + ".tmp");
+    BinWritter_t<BinCoreOpenMode::NoBuffer> outData(dataPath + ".tmp");
     std::sort(files.begin(), files.end());
+    std::map<uint32, std::vector<IFile *>> classFiles;
+
+    for (auto &f : files) {
+      classFiles[f.info.type].push_back(&f);
+    }
 
     pc::Cache outCache;
     outCache.files.numItems = files.size();
@@ -192,62 +431,141 @@ struct MakeContext : AppPackContext {
     outCache.blocks.pointer =
         outIdx.Tell() - offsetof(pc::Cache, blocks.pointer);
 
-    constexpr size_t BLOCK_SIZE = 0x40000;
-    char block[BLOCK_SIZE]{};
-    size_t blockAvail = BLOCK_SIZE;
+    constexpr size_t BLOCK_SIZE = pc::Cache::BLOCK_SIZE;
+    std::string block;
+    block.reserve(BLOCK_SIZE);
+
+    // Blocks are handed back in order they were sent
+    std::deque<uint32> rawCrcs;
+    size_t numReused = 0;
+
+    BlockCompressor compressor(
+        prime::utils::WorkerPool(),
+        [&](const std::string &compressed, uint32 dictionary) {
+          outCache.blocks.numItems++;
+          pc::CacheBlock nBlock{
+              .offset = outData.Tell(),
+              .size = uint32(compressed.size()),
+              .crc = crc32b(0, compressed.data(), compressed.size()),
+              .dictionary = dictionary,
+              .rawCrc = rawCrcs.front(),
+          };
+
+          rawCrcs.pop_front();
+
+          outIdx.Write(nBlock);
+          outData.WriteContainer(compressed);
+        });
+
+    struct CDictDeleter {
+      void operator()(ZSTD_CDict *dict) const { ZSTD_freeCDict(dict); }
+    };
 
-    ZSTD_CCtx *zctx = ZSTD_createCCtx();
-    std::string zBuffer;
-    zBuffer.resize(ZSTD_compressBound(BLOCK_SIZE));
+    std::vector<std::pair<uint32, std::string>> dictionaries;
+    std::vector<std::unique_ptr<ZSTD_CDict, CDictDeleter>> cdicts;
+    size_t numBlocks = 0;
 
+    // Each class is placed from block boundary in ResourceHash order,
+    // so block is compressed with single dictionary and layout does not
+    // depend on order of SendFile calls
     for (auto &[clHash, stream] : streams) {
       es::Dispose(stream.streamStore);
-      stream.blobalOffset = outData.Tell();
+      stream.blobalOffset = numBlocks * BLOCK_SIZE;
       BinReader rd(stream.streamPath);
-      size_t streamSize = rd.GetSize();
+      auto &clFiles = classFiles[clHash];
+      uint32 dictIndex = 0;
+      const ZSTD_CDict *cdict = nullptr;
 
-      while (streamSize) {
-        size_t blockFill = std::min(blockAvail, streamSize);
-        streamSize -= blockFill;
-        rd.ReadBuffer(block + (BLOCK_SIZE - blockAvail), blockFill);
-        blockAvail -= blockFill;
+      std::string dict;
 
-        if (blockAvail == 0) {
-          outCache.blocks.numItems++;
-          const uint32 cSize =
-              ZSTD_compressCCtx(zctx, zBuffer.data(), zBuffer.size(), block,
-                                BLOCK_SIZE, ZSTD_btultra);
+      // Keeping previous dictionary allows to reuse blocks of this class
+      if (incremental && prevCache.dictionaries.contains(clHash)) {
+        dict = prevCache.dictionaries.at(clHash);
+      } else {
+        dict = TrainDictionary(rd, clFiles);
+      }
 
-          pc::CacheBlock nBlock{
-              .offset = outData.Tell(),
-              .size = cSize,
-              .crc = crc32b(0, zBuffer.data(), cSize),
-          };
+      if (!dict.empty()) {
+        cdicts.emplace_back(
+            ZSTD_createCDict(dict.data(), dict.size(), ZSTD_btultra));
+        cdict = cdicts.back().get();
+        dictionaries.emplace_back(clHash, std::move(dict));
+        dictIndex = dictionaries.size();
+      }
 
-          outIdx.Write(nBlock);
-          outData.WriteBuffer(zBuffer.data(), cSize);
-          blockAvail = BLOCK_SIZE;
+      auto SendBlock = [&] {
+        rawCrcs.push_back(crc32b(0, block.data(), block.size()));
+        numBlocks++;
+
+        if (incremental) {
+          std::string reused = prevCache.Find(cdict ? clHash : 0, block);
+
+          if (!reused.empty()) {
+            compressor.SendCompressed(std::move(reused), dictIndex);
+            numReused++;
+            block = {};
+            block.reserve(BLOCK_SIZE);
+            return;
+          }
+        }
+
+        compressor.Send(std::move(block), dictIndex, cdict);
+        block = {};
+        block.reserve(BLOCK_SIZE);
+      };
+
+      size_t streamOffset = 0;
+
+      auto PadBlock = [&](size_t size) {
+        streamOffset += size - block.size();
+        block.resize(size);
+
+        if (block.size() == BLOCK_SIZE) {
+          SendBlock();
+        }
+      };
+
+      for (IFile *f : clFiles) {
+        // File is placed where it was within block before, so changed size
+        // of previous file does not shift every block after it
+        if (auto found = prevCache.microOffsets.find(f->info);
+            incremental && found != prevCache.microOffsets.end()) {
+          if (block.size() > found->second) {
+            PadBlock(BLOCK_SIZE);
+          }
+
+          PadBlock(found->second);
+        }
+
+        rd.Seek(f->location.offset);
+        f->location.offset = streamOffset;
+        streamOffset += f->location.size;
+
+        for (size_t fileSize = f->location.size; fileSize;) {
+          const size_t blockBegin = block.size();
+          const size_t blockFill = std::min(BLOCK_SIZE - blockBegin, fileSize);
+          fileSize -= blockFill;
+          block.resize(blockBegin + blockFill);
+          rd.ReadBuffer(block.data() + blockBegin, blockFill);
+
+          if (block.size() == BLOCK_SIZE) {
+            SendBlock();
+          }
         }
       }
 
+      if (!block.empty()) {
+        SendBlock();
+      }
+
       es::Dispose(rd);
       es::RemoveFile(stream.streamPath);
     }
 
-    if (blockAvail != BLOCK_SIZE) {
-
-      outCache.blocks.numItems++;
-      const uint32 cSize =
-          ZSTD_compressCCtx(zctx, zBuffer.data(), zBuffer.size(), block,
-                            BLOCK_SIZE - blockAvail, ZSTD_btultra);
-      pc::CacheBlock nBlock{
-          .offset = outData.Tell(),
-          .size = cSize,
-          .crc = crc32b(0, zBuffer.data(), cSize),
-      };
+    compressor.Flush();
 
-      outIdx.Write(nBlock);
-      outData.WriteBuffer(zBuffer.data(), cSize);
+    if (incremental) {
+      PrintInfo("Reused ", numReused, " of ", numBlocks, " blocks.");
     }
 
     outIdx.ApplyPadding(alignof(pc::CacheFile));
@@ -267,8 +585,45 @@ struct MakeContext : AppPackContext {
       outIdx.Write(file);
     }
 
+    outIdx.ApplyPadding(alignof(pc::CacheDictionary));
+    const size_t dictsBegin = outIdx.Tell();
+    outCache.dictionaries.numItems = dictionaries.size();
+    outCache.dictionaries.pointer =
+        dictsBegin - offsetof(pc::Cache, dictionaries.pointer);
+    size_t dictDataOffset =
+        dictsBegin + dictionaries.size() * sizeof(pc::CacheDictionary);
+
+    for (auto &[clHash, dict] : dictionaries) {
+      pc::CacheDictionary cDict{};
+      cDict.classHash = clHash;
+      cDict.data.numItems = dict.size();
+      cDict.data.pointer =
+          dictDataOffset -
+          (outIdx.Tell() + offsetof(pc::CacheDictionary, data.pointer));
+      dictDataOffset += dict.size();
+      outIdx.Write(cDict);
+    }
+
+    for (auto &[clHash, dict] : dictionaries) {
+      outIdx.WriteContainer(dict);
+    }
+
     outIdx.Seek(0);
     outIdx.Write(outCache);
+    es::Dispose(outIdx);
+    es::Dispose(outData);
+
+    if (std::rename((dataPath + ".tmp").c_str(), dataPath.c_str()) ||
+        std::rename((indexPath + ".tmp").c_str(), indexPath.c_str())) {
+      throw std::runtime_error("Cannot replace " + baseFile + ": " +
+                               strerror(errno));
+    }
+
+    prevCache.Commit();
+
+    if (debugSidecar) {
+      debugSidecar->Finish();
+    }
   }
 };
 
@@ -0,0 +1,46 @@
+/*  PrimeCache
+    Copyright(C) 2023 Lukas Cone
+
+    This program is free software : you can redistribute it and / or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "strippers.hpp"
+#include "utils/debug.hpp"
+#include <cstring>
+
+StrippedResource StripResourceDebug(BinReaderRef rd) {
+  namespace pu = prime::utils;
+  StrippedResource retVal;
+  rd.ReadContainer(retVal.payload, rd.GetSize());
+  const size_t dataSize = retVal.payload.size();
+
+  if (dataSize < sizeof(pu::ResourceDebugFooter)) {
+    return retVal;
+  }
+
+  pu::ResourceDebugFooter footer;
+  memcpy(&footer, retVal.payload.data() + dataSize - sizeof(footer),
+         sizeof(footer));
+
+  // Raw files can end with anything, footer must point before itself
+  if (footer.id != pu::ResourceDebugFooter::ID ||
+      size_t(footer.dataSize) + footer.pad > dataSize - sizeof(footer)) {
+    return retVal;
+  }
+
+  retVal.debug = retVal.payload.substr(footer.dataSize);
+  retVal.payload.resize(footer.dataSize);
+
+  return retVal;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "spike/io/binreader.hpp"
+#include <string>
+
+struct StrippedResource {
+  // Runtime data, stored in main archive
+  std::string payload;
+  // Everything behind payload, stored in .debug sidecar, empty if resource
+  // has nothing to strip
+  // Appending it back to payload gives original resource
+  std::string debug;
+};
+
+// Splits off ResourceDebug located by ResourceDebugFooter
+// Every compiled class ends with the footer, so single stripper covers all
+StrippedResource StripResourceDebug(BinReaderRef rd);
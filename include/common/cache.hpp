@@ -0,0 +1,84 @@
+#pragma once
+#include "array.hpp"
+#include "resource_hash.hpp"
+#include <string>
+
+namespace prime::common {
+struct CacheFile;
+struct CacheBlock;
+struct CacheDictionary;
+struct Cache;
+} // namespace prime::common
+
+HASH_CLASS(prime::common::CacheFile);
+HASH_CLASS(prime::common::CacheBlock);
+HASH_CLASS(prime::common::CacheDictionary);
+CLASS_RESOURCE(3, prime::common::Cache);
+
+namespace prime::common {
+struct CacheFile {
+  ResourceHash info;
+  uint64 blockOffset : 20; // 255GiB
+  uint64 microOffset : 18; // BLOCK_SIZE
+  uint64 tailSize : 18;    // BLOCK_SIZE
+  uint64 numBlocks : 8;    // 64MiB
+};
+
+static_assert(sizeof(CacheFile) == 16);
+
+struct CacheBlock {
+  uint64 offset;
+  uint32 size;
+  uint32 crc;
+  // Index into Cache::dictionaries + 1, 0 for block without dictionary
+  uint32 dictionary;
+  // crc32b of decompressed data, used by incremental make_cache
+  uint32 rawCrc;
+};
+
+// zstd dictionary trained from resources of a single class
+struct CacheDictionary {
+  uint32 classHash;
+  LocalArray32<char> data;
+};
+
+// Index of <name>.dat blob, files are sorted by ResourceHash
+// Blob is a sequence of zstd frames, each holding up to BLOCK_SIZE of data
+// Every class starts at block boundary, so block holds only single class
+struct Cache : Resource<Cache> {
+  static constexpr size_t BLOCK_SIZE = 0x40000;
+  LocalArray32<CacheFile> files;
+  LocalArray32<CacheBlock> blocks;
+  LocalArray32<CacheDictionary> dictionaries;
+};
+
+// Decompress resource from mounted cache archives into buffer
+// Returns ERROR_KEY_NOT_FOUND_IN_MAP without any message if resource is not
+// archived
+Return<void> ReadCacheResource(ResourceHash hash, std::string &buffer);
+// Ends every entry of .debug sidecar, binds it to payload it was stripped from
+struct CacheDebugTrailer {
+  // crc32b of payload in main archive
+  uint32 payloadCrc;
+};
+
+// Mounts <path>.debug sidecar made by make_cache --strip-debug, path is the
+// same as for AddCacheArchive
+// Stripped ResourceDebug is appended back to resources read by
+// ReadCacheResource, for diagnostics and dependency tracking
+// Sidecar entry is skipped when payload differs from one it was stripped from
+Return<void> AddCacheDebugArchive(const std::string &path);
+bool IsCachedResource(ResourceHash hash);
+
+struct CacheBlockStats {
+  uint64 numHits;
+  uint64 numMisses;
+  size_t usedBytes;
+  size_t budget;
+};
+
+// Memory budget for decompressed blocks shared by multiple resources
+// Default is 16MiB, 0 disables block caching
+void SetCacheBlockBudget(size_t numBytes);
+CacheBlockStats GetCacheBlockStats();
+} // namespace prime::common
@@ -11,6 +11,8 @@
   prime::common::ReturnStatus { 3 }
 #define ERROR_INVALID_VERSION                                                  \
   prime::common::ReturnStatus { 4 }
+#define ERROR_RESOURCE_NOT_FOUND                                               \
+  prime::common::ReturnStatus { 5 }
 
 namespace prime::common {
 struct ReturnStatus {
@@ -0,0 +1,275 @@
+#pragma once
+#include "resource_hash.hpp"
+#include <bit>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace prime::common {
+template <class K> uint64 FlatHashKey(const K &key) {
+  if constexpr (std::is_same_v<K, ResourceHash>) {
+    return key.hash;
+  } else if constexpr (std::is_pointer_v<K>) {
+    return reinterpret_cast<uintptr_t>(key);
+  } else {
+    static_assert(std::is_integral_v<K>, "Unsupported key type");
+    return uint64(key);
+  }
+}
+
+// Open addressing hash map with linear probing
+// Slots hold only 32bit fingerprint and index into value storage, so probing
+// stays within few cache lines
+// Values live in deque, their addresses are stable until erased
+template <class K, class V, class A = std::allocator<std::pair<const K, V>>>
+class FlatHashMap {
+  struct Slot {
+    uint32 fingerprint;
+    uint32 index; // index + 1 into values, 0 is empty slot
+  };
+
+  template <class T>
+  using Alloc = typename std::allocator_traits<A>::template rebind_alloc<T>;
+
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<const K, V>;
+  using allocator_type = A;
+
+  FlatHashMap() = default;
+  explicit FlatHashMap(const A &alloc)
+      : slots(alloc), values(alloc), freeValues(alloc) {}
+
+  template <class VT, class Base> struct Iterator {
+    Base *values;
+    size_t index;
+
+    VT &operator*() const { return *(*values)[index]; }
+    VT *operator->() const { return &*(*values)[index]; }
+    bool operator==(const Iterator &o) const { return index == o.index; }
+
+    Iterator &operator++() {
+      index++;
+      Skip();
+      return *this;
+    }
+
+    void Skip() {
+      while (index < values->size() && !(*values)[index]) {
+        index++;
+      }
+    }
+  };
+
+  using Storage =
+      std::deque<std::optional<value_type>, Alloc<std::optional<value_type>>>;
+  using iterator = Iterator<value_type, Storage>;
+  using const_iterator = Iterator<const value_type, const Storage>;
+
+  iterator begin() { return MakeIter<iterator>(values, 0); }
+  iterator end() { return {&values, values.size()}; }
+  const_iterator begin() const { return MakeIter<const_iterator>(values, 0); }
+  const_iterator end() const { return {&values, values.size()}; }
+
+  size_t size() const { return numItems; }
+  bool empty() const { return numItems == 0; }
+
+  void clear() {
+    slots.clear();
+    values.clear();
+    freeValues.clear();
+    numItems = 0;
+  }
+
+  void reserve(size_t numElements) {
+    const size_t numSlots =
+        std::bit_ceil(std::max(numElements * 4 / 3 + 1, size_t(8)));
+
+    if (numSlots > slots.size()) {
+      Rehash(numSlots);
+    }
+  }
+
+  iterator find(const K &key) {
+    const size_t slot = FindSlot(key);
+    return slot == NOT_FOUND ? end() : iterator{&values, slots[slot].index - 1};
+  }
+
+  const_iterator find(const K &key) const {
+    const size_t slot = FindSlot(key);
+    return slot == NOT_FOUND ? end()
+                             : const_iterator{&values, slots[slot].index - 1};
+  }
+
+  bool contains(const K &key) const { return FindSlot(key) != NOT_FOUND; }
+
+  V &at(const K &key) {
+    const size_t slot = FindSlot(key);
+
+    if (slot == NOT_FOUND) {
+      throw std::out_of_range("FlatHashMap::at");
+    }
+
+    return values[slots[slot].index - 1]->second;
+  }
+
+  const V &at(const K &key) const {
+    return const_cast<FlatHashMap *>(this)->at(key);
+  }
+
+  V &operator[](const K &key) { return try_emplace(key).first->second; }
+
+  template <class... C>
+  std::pair<iterator, bool> try_emplace(const K &key, C &&...args) {
+    if (auto found = find(key); found != end()) {
+      return {found, false};
+    }
+
+    return {Insert(key, std::forward<C>(args)...), true};
+  }
+
+  template <class... C> std::pair<iterator, bool> emplace(C &&...args) {
+    value_type item(std::forward<C>(args)...);
+    return try_emplace(item.first, std::move(item.second));
+  }
+
+  std::pair<iterator, bool> insert(value_type &&item) {
+    return try_emplace(item.first, std::move(item.second));
+  }
+
+  template <class C>
+  std::pair<iterator, bool> insert_or_assign(const K &key, C &&value) {
+    if (auto found = find(key); found != end()) {
+      found->second = std::forward<C>(value);
+      return {found, false};
+    }
+
+    return {Insert(key, std::forward<C>(value)), true};
+  }
+
+  size_t erase(const K &key) {
+    size_t slot = FindSlot(key);
+
+    if (slot == NOT_FOUND) {
+      return 0;
+    }
+
+    const uint32 valueIndex = slots[slot].index - 1;
+    values[valueIndex].reset();
+    freeValues.push_back(valueIndex);
+    numItems--;
+
+    // Backward shift deletion, no tombstones needed
+    const size_t mask = slots.size() - 1;
+
+    for (size_t next = (slot + 1) & mask; slots[next].index;
+         next = (next + 1) & mask) {
+      const size_t home = slots[next].fingerprint & mask;
+
+      if (((next - home) & mask) >= ((next - slot) & mask)) {
+        slots[slot] = slots[next];
+        slot = next;
+      }
+    }
+
+    slots[slot] = {};
+    return 1;
+  }
+
+private:
+  static constexpr size_t NOT_FOUND = -1;
+  std::vector<Slot, Alloc<Slot>> slots;
+  Storage values;
+  std::vector<uint32, Alloc<uint32>> freeValues;
+  size_t numItems = 0;
+
+  template <class I, class S> static I MakeIter(S &values, size_t index) {
+    I retVal{&values, index};
+    retVal.Skip();
+    return retVal;
+  }
+
+  static uint32 Fingerprint(const K &key) {
+    // murmur3 fmix64
+    uint64 h = FlatHashKey(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return uint32(h);
+  }
+
+  size_t FindSlot(const K &key) const {
+    if (slots.empty()) {
+      return NOT_FOUND;
+    }
+
+    const uint32 fingerprint = Fingerprint(key);
+    const size_t mask = slots.size() - 1;
+
+    for (size_t s = fingerprint & mask; slots[s].index; s = (s + 1) & mask) {
+      if (slots[s].fingerprint == fingerprint &&
+          FlatHashKey(values[slots[s].index - 1]->first) == FlatHashKey(key)) {
+        return s;
+      }
+    }
+
+    return NOT_FOUND;
+  }
+
+  void PlaceSlot(Slot item) {
+    const size_t mask = slots.size() - 1;
+    size_t s = item.fingerprint & mask;
+
+    while (slots[s].index) {
+      s = (s + 1) & mask;
+    }
+
+    slots[s] = item;
+  }
+
+  void Rehash(size_t numSlots) {
+    std::vector<Slot, Alloc<Slot>> oldSlots(numSlots, Slot{},
+                                            slots.get_allocator());
+    std::swap(slots, oldSlots);
+
+    for (Slot &s : oldSlots) {
+      if (s.index) {
+        PlaceSlot(s);
+      }
+    }
+  }
+
+  template <class... C> iterator Insert(const K &key, C &&...args) {
+    // Max load factor 3/4
+    if ((numItems + 1) * 4 > slots.size() * 3) {
+      Rehash(std::max(slots.size() * 2, size_t(8)));
+    }
+
+    uint32 valueIndex;
+
+    if (freeValues.empty()) {
+      valueIndex = values.size();
+      values.emplace_back(std::in_place, std::piecewise_construct,
+                          std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<C>(args)...));
+    } else {
+      valueIndex = freeValues.back();
+      freeValues.pop_back();
+      values[valueIndex].emplace(
+          std::piecewise_construct, std::forward_as_tuple(key),
+          std::forward_as_tuple(std::forward<C>(args)...));
+    }
+
+    PlaceSlot({Fingerprint(key), valueIndex + 1});
+    numItems++;
+    return {&values, valueIndex};
+  }
+};
+} // namespace prime::common
@@ -0,0 +1,154 @@
+#pragma once
+#include "spike/util/supercore.hpp"
+#include <algorithm>
+#include <bit>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace prime::common {
+// Read only map over fixed key set, built once without any collisions
+// Keys are spread into buckets, every bucket gets displacement which moves
+// its keys into free slots (hash and displace)
+// Lookup is one displacement load, one slot load and single key compare
+// Bucket without displacement below MAX_DISPLACEMENT restarts build with
+// twice as many slots
+template <class K, class V, uint32 MAX_DISPLACEMENT = 0x10000>
+class PerfectHashMap {
+  static_assert(std::is_integral_v<K>, "Unsupported key type");
+
+  struct Slot {
+    K key;
+    V value;
+    bool used = false;
+  };
+
+public:
+  PerfectHashMap() = default;
+
+  // Duplicate keys keep first value
+  PerfectHashMap(std::span<const std::pair<K, V>> items) {
+    std::vector<std::pair<K, V>> unique;
+    std::set<K> seen;
+    unique.reserve(items.size());
+
+    for (auto &i : items) {
+      if (seen.insert(i.first).second) {
+        unique.push_back(i);
+      }
+    }
+
+    // Load factor of 0.5 keeps displacement search short
+    for (size_t numSlots = std::bit_ceil(unique.size() * 2 + 1);;
+         numSlots *= 2) {
+      if (Build(unique, numSlots)) {
+        break;
+      }
+    }
+  }
+
+  const V *find(K key) const {
+    if (slots.empty()) {
+      return nullptr;
+    }
+
+    const uint64 h = Mix(uint64(key));
+    const Slot &slot =
+        slots[SlotIndex(h, displacements[h & (displacements.size() - 1)])];
+    return slot.used && slot.key == key ? &slot.value : nullptr;
+  }
+
+  size_t size() const { return numItems; }
+  size_t capacity() const { return slots.size(); }
+
+private:
+  std::vector<uint32> displacements;
+  std::vector<Slot> slots;
+  size_t numItems = 0;
+
+  static uint64 Mix(uint64 h) {
+    // murmur3 fmix64
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // Whole hash is mixed, keys differing only in bits used for bucket must
+  // not land in same slot for every displacement
+  size_t SlotIndex(uint64 h, uint32 displacement) const {
+    return Mix(h ^ (uint64(displacement) * 0x9e3779b97f4a7c15ULL)) &
+           (slots.size() - 1);
+  }
+
+  bool Build(std::span<const std::pair<K, V>> items, size_t numSlots) {
+    const size_t numBuckets = std::bit_ceil(items.size() / 4 + 1);
+    std::vector<std::vector<uint32>> buckets(numBuckets);
+
+    for (uint32 i = 0; i < items.size(); i++) {
+      buckets[Mix(uint64(items[i].first)) & (numBuckets - 1)].push_back(i);
+    }
+
+    std::vector<uint32> order(numBuckets);
+
+    for (uint32 i = 0; i < numBuckets; i++) {
+      order[i] = i;
+    }
+
+    // Fullest buckets first, while there is most room left
+    std::stable_sort(order.begin(), order.end(), [&](uint32 a, uint32 b) {
+      return buckets[a].size() > buckets[b].size();
+    });
+
+    displacements.assign(numBuckets, 0);
+    slots.assign(numSlots, {});
+    std::vector<size_t> taken;
+
+    for (uint32 b : order) {
+      auto &bucket = buckets[b];
+
+      if (bucket.empty()) {
+        break;
+      }
+
+      uint32 d = 0;
+
+      for (; d < MAX_DISPLACEMENT; d++) {
+        taken.clear();
+
+        for (uint32 i : bucket) {
+          const size_t s = SlotIndex(Mix(uint64(items[i].first)), d);
+
+          if (slots[s].used ||
+              std::find(taken.begin(), taken.end(), s) != taken.end()) {
+            break;
+          }
+
+          taken.push_back(s);
+        }
+
+        if (taken.size() == bucket.size()) {
+          break;
+        }
+      }
+
+      if (d == MAX_DISPLACEMENT) {
+        return false;
+      }
+
+      displacements[b] = d;
+
+      for (size_t i = 0; i < bucket.size(); i++) {
+        slots[taken[i]] = {items[bucket[i]].first, items[bucket[i]].second,
+                           true};
+      }
+    }
+
+    numItems = items.size();
+    return true;
+  }
+};
+} // namespace prime::common
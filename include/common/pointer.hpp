@@ -52,6 +52,9 @@ template <class C> struct Pointer {
   const C &operator*() const { return *resourcePtr; }
   const C *operator->() const { return resourcePtr; }
 
+  // Valid only while unlinked, for reporting failed links
+  const ResourceHash &Hash() const { return resourceHash; }
+
 private:
   template <class D> friend D *LinkResource(Pointer<D> &);
   union {
@@ -1,7 +1,11 @@
 #pragma once
 #include "pointer.hpp"
 #include "spike/crypto/jenkinshash3.hpp"
+#include <future>
+#include <map>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace prime::common {
 template <class C> ResourceHash MakeHash(uint32 name) {
@@ -21,10 +25,58 @@ struct ResourcePath {
   std::string AbsPath() const { return std::string(workingDir) + localPath; }
 };
 
+// Resource memory, either heap string or private file mapping
+// Mapping is copy on write, so untouched pages are shared with page cache and
+// in place fixups done by Process handlers copy only pages they touch
+// Mapped data is page aligned, which satisfies any ResourceBase::maxAlign
+class ResourceBuffer {
+public:
+  ResourceBuffer() = default;
+  ResourceBuffer(std::string &&data) : heap(std::move(data)) {}
+  // Copy is always heap backed
+  ResourceBuffer(const ResourceBuffer &other)
+      : heap(other.data(), other.size()) {}
+  ResourceBuffer(ResourceBuffer &&other) { *this = std::move(other); }
+  ~ResourceBuffer() { Unmap(); }
+
+  ResourceBuffer &operator=(const ResourceBuffer &other) {
+    return *this = std::string(other.data(), other.size());
+  }
+  ResourceBuffer &operator=(ResourceBuffer &&other);
+  ResourceBuffer &operator=(std::string &&data) {
+    Unmap();
+    heap = std::move(data);
+    return *this;
+  }
+
+  char *data() { return mapped ? mapped : heap.data(); }
+  const char *data() const { return mapped ? mapped : heap.data(); }
+  size_t size() const { return mapped ? mappedSize : heap.size(); }
+  bool empty() const { return size() == 0; }
+  bool IsMapped() const { return mapped; }
+  operator std::string_view() const { return {data(), size()}; }
+
+  // Mapped data is moved to heap first
+  void resize(size_t newSize);
+  // Returns errno on failure, file can be closed afterwards
+  int Map(int fd, size_t fileSize);
+
+private:
+  std::string heap;
+  char *mapped = nullptr;
+  size_t mappedSize = 0;
+
+  void Unmap();
+};
+
 struct ResourceData {
   ResourceHash hash;
-  std::string buffer;
+  ResourceBuffer buffer;
   int32 numRefs = 0;
+  // Set after ResourceHandle::Process, cleared after ResourceHandle::Delete
+  bool isProcessed = false;
+  // Tick of last load, resources are evicted from lowest
+  uint64 lastUse = 0;
 
   template <class C> Return<C*> As() {
     C *item = reinterpret_cast<C *>(buffer.data());
@@ -40,7 +92,22 @@ struct ResourceData {
 };
 
 // Resource data
+// Throws es::FileNotFoundError for missing resource
 ResourceData &LoadResource(ResourceHash hash, bool reload = false);
+// Missing resource is reported as ERROR_RESOURCE_NOT_FOUND, without throwing
+Return<ResourceData *> TryLoadResource(ResourceHash hash, bool reload = false);
+// Reads all resource files in single batch, returned in order of hashes
+std::vector<ResourceData *> LoadResources(std::span<const ResourceHash> hashes);
+// Dependencies of loaded resource, taken from its ResourceDebug
+std::vector<ResourceHash> ResourceDependencies(ResourceHash hash);
+// Change of dependency triggers ResourceHandle::Update of dependent
+// Dependencies from ResourceDebug are added automatically
+void AddReloadDependency(ResourceHash dependency, ResourceHash dependent);
+// File IO and conversion runs on worker pool, ResourceHandle::Process is
+// called from ProcessLoadedResources on thread that requested the resource
+std::shared_future<ResourceData *> AsyncLoadResource(ResourceHash hash);
+// Called by PollUpdates
+void ProcessLoadedResources();
 ResourceData &FindResource(const void *address);
 const ResourcePath &FindResource(ResourceHash hash);
 void FreeResource(ResourceData &resource);
@@ -50,6 +117,27 @@ const ResourcePath &FindResource(JenHash3 name) {
   return FindResource(MakeHash<C>(name));
 }
 
+// Residency
+struct ResidencyStats {
+  size_t usedBytes = 0;
+  size_t budget = 0;
+  size_t numEvictions = 0;
+  // Resident bytes per class hash
+  std::map<uint32, size_t> classBytes;
+};
+
+// Once resident data exceed budget, resources without references are
+// evicted in least recently loaded order, ResourceHandle::Delete is called
+// before eviction
+// Processed resources of handles without Delete are never evicted
+// Resources loaded since previous TrimResources are not evicted, so
+// ResourceData returned by LoadResource is valid until end of frame without
+// reference, numRefs must be held to keep it longer
+void SetResidencyBudget(size_t bytes);
+ResidencyStats GetResidencyStats();
+// Called periodically by PollUpdates
+void TrimResources();
+
 // Project data
 void ProjectDataFolder(std::string_view path);
 const std::string &ProjectDataFolder();
@@ -58,6 +146,9 @@ const std::string &CacheDataFolder();
 // Working folders
 void AddWorkingFolder(std::string path);
 
+// Cache archives made by make_cache, path is without extension
+Return<void> AddCacheArchive(const std::string &path);
+
 // Resource registry
 Return<void> RegisterResource(std::string path);
 void AddSimpleResource(ResourceData &&resource);
@@ -92,9 +183,15 @@ template <class C> C *LinkResource(Pointer<C> &resource) {
     return nullptr;
   }
 
-  auto &resData = LoadResource(resource.resourceHash);
-  resource.resourcePtr = static_cast<C *>(GetResourceHandle(resData));
-  resData.numRefs++;
+  // Missing resource stays unlinked
+  auto resData = TryLoadResource(resource.resourceHash);
+
+  if (resData.status) {
+    return nullptr;
+  }
+
+  resource.resourcePtr = static_cast<C *>(GetResourceHandle(*resData.retVal));
+  resData.retVal->numRefs++;
 
   return resource;
 }
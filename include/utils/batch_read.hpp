@@ -0,0 +1,27 @@
+#pragma once
+#include "common/resource.hpp"
+#include <span>
+#include <string>
+#include <vector>
+
+namespace prime::utils {
+struct ReadRequest {
+  // Tried in order, first existing file is read
+  std::vector<std::string> paths;
+  common::ResourceBuffer *buffer = nullptr;
+  // Large file found through first numMappable paths is mapped instead of
+  // read. Only for files replaced by rename, private mapping of file written
+  // in place changes under the reader
+  size_t numMappable = 0;
+  // errno of failed request, ENOENT if none of paths exist
+  int error = 0;
+};
+
+// Mappable files of this size and above are mapped instead of read
+inline constexpr size_t MAP_THRESHOLD = 0x40000;
+
+// Reads requests through io_uring, few hundred files are open at a time
+// Falls back to pread on worker pool when io_uring is not available
+// Does not throw, check ReadRequest::error instead
+void BatchRead(std::span<ReadRequest> requests);
+} // namespace prime::utils
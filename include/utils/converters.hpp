@@ -21,6 +21,12 @@ std::span<std::string_view> ProcessImageFilters();
 void ContextOutputPath(std::string output);
 ContextType MakeContext(const std::string &filePath);
 
+// Project cache files are written under temporary name and renamed over
+// target once complete, loader may still map previous file
+std::string TempCachePath(const std::string &path);
+// Replaces path with its temporary file
+void CommitCachePath(const std::string &path);
+
 bool ConvertResource(const common::ResourcePath &path);
 
 using CompileFunc = common::Return<void> (*)(std::string buffer,
@@ -0,0 +1,31 @@
+#pragma once
+#include "spike/util/supercore.hpp"
+#include <string>
+
+struct rgba_surface;
+struct bc7_enc_settings;
+
+namespace prime::utils {
+enum class BlockFormat : uint8 {
+  BC1,
+  BC3,
+  BC4,
+  BC5,
+  BC5S,
+  BC7,
+};
+
+// Bytes per 4x4 block
+uint32 BlockSize(BlockFormat format);
+
+// Compresses surface in bands of block rows on worker pool
+// Output is identical to compressing whole surface at once
+// Calling thread compresses bands as well, so it is safe to call from
+// worker pool task
+// bc7Settings are required only for BC7, throws std::invalid_argument if
+// missing
+// numThreads limits number of threads working on surface, 0 is no limit
+std::string CompressBlocks(const rgba_surface &surface, BlockFormat format,
+                           const bc7_enc_settings *bc7Settings = nullptr,
+                           uint32 numThreads = 0);
+} // namespace prime::utils
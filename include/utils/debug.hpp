@@ -1,9 +1,11 @@
+#include "common/flat_hash_map.hpp"
 #include "common/local_pointer.hpp"
 #include "common/resource.hpp"
 #include "common/string.hpp"
 #include "reflect.hpp"
 #include "spike/util/supercore.hpp"
 #include "utils/playground.hpp"
+#include <string>
 
 namespace prime::utils {
 struct ResourceDebugDependency;
@@ -72,6 +74,8 @@ struct ResourceDebugPlayground : PlayGround {
   Pointer<ResourceDebug> main;
 
   ResourceDebugPlayground();
+  // Starts new empty debug, main stays valid
+  void Reset();
   common::ResourceHash AddRef(std::string_view path_, uint32 clHash);
   std::string_view AddString(std::string_view str);
 
@@ -83,5 +87,15 @@ struct ResourceDebugPlayground : PlayGround {
 
 private:
   Pointer<ResourceDebugClass> AddDebugClass(const reflect::Class *cls);
+
+  // Keyed by string hash, colliding strings take next free key
+  // Values are array indices, which survive array moves
+  using Index = common::FlatHashMap<
+      uint64, uint32,
+      std::pmr::polymorphic_allocator<std::pair<const uint64, uint32>>>;
+
+  Index dependencyIndex;
+  Index stringIndex;
+  Index classIndex;
 };
 } // namespace prime::utils
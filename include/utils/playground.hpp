@@ -5,12 +5,18 @@
 #include "spike/util/supercore.hpp"
 #include <algorithm>
 #include <cassert>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <set>
 #include <string>
 #include <vector>
 namespace prime::utils {
 
 struct PlayGround {
-  PlayGround() = default;
+  // Backing memory is taken from per thread cache and returned to it on
+  // destruction, so batch conversions reuse it
+  PlayGround();
   PlayGround(const PlayGround &) = delete;
   PlayGround(PlayGround &&) = delete;
 
@@ -31,26 +37,46 @@ private:
     BtPointer &operator=(BtPointer &&) = delete;
 
     ~BtPointer() { UnRegister(); }
+    // Live pointers form intrusive list, so both operations are O(1)
     void Register() {
       if (owner == nullptr) {
         return;
       }
 
-      assert([&] {
-        auto found =
-            std::find(owner->pointers.begin(), owner->pointers.end(), this);
-        return found == owner->pointers.end();
-      }());
-      owner->pointers.push_back(this);
+      next = owner->pointers;
+
+      if (next) {
+        next->prev = this;
+      }
+
+      owner->pointers = this;
     }
     void UnRegister() {
-      if (owner) {
-        std::erase(owner->pointers, this);
+      if (owner == nullptr) {
+        return;
       }
+
+      if (prev) {
+        prev->next = next;
+      } else if (owner->pointers == this) {
+        owner->pointers = next;
+      } else {
+        // Already unregistered by move
+        return;
+      }
+
+      if (next) {
+        next->prev = prev;
+      }
+
+      prev = nullptr;
+      next = nullptr;
     }
 
     uint32 offset;
     PlayGround *owner;
+    BtPointer *prev = nullptr;
+    BtPointer *next = nullptr;
   };
 
 public:
@@ -150,9 +176,16 @@ public:
   }
 
   std::string Build();
+  // Drops all data, keeps memory for reuse
+  // Pointers from before reset must not be used
+  void Reset();
 
   template <class C> C *As() { return reinterpret_cast<C *>(data.data()); }
 
+protected:
+  // For indexes of derived playgrounds, reused together with data
+  std::pmr::memory_resource *IndexPool() { return &arena->pool; }
+
 private:
   template <class C, class D>
   Pointer<common::LocalArray<C, D>>
@@ -170,10 +203,8 @@ private:
 
     if (numItems == 0) {
       using ArrayType = common::LocalArray<C, D>;
-      localPointers.emplace_back(LocalPointer{
-          .pointsTo = ptr.offset,
-          .offset = array.offset + uint32(offsetof(ArrayType, pointer)),
-          .size = sizeof(D)});
+      SetLocalPointer(array.offset + uint32(offsetof(ArrayType, pointer)),
+                      ptr.offset, sizeof(D));
     }
     array->pointer = Relative(*ptr, array->pointer);
     return array;
@@ -184,18 +215,9 @@ private:
     const intptr_t badr = reinterpret_cast<intptr_t>(&b);
     return aadr - badr;
   }
-  struct Gap {
-    uint32 begin;
-    uint32 end;
-
-    bool operator==(const Gap &other) const {
-      return (begin == other.begin) && (end == other.end);
-    }
-  };
-
+  // Keyed by offset of pointer itself
   struct LocalPointer {
     uint32 pointsTo;
-    uint32 offset;
     uint32 size;
   };
 
@@ -203,6 +225,8 @@ private:
     uint32 begin;
     uint32 end;
     uint32 alignment;
+    // Allocation order, moved block counts as new one
+    uint32 order;
 
     std::string_view View(PlayGround *pg) {
       return {pg->data.data() + begin, pg->data.data() + end};
@@ -215,14 +239,45 @@ private:
 
   BtPointer Allocate(uint32 size, uint32 alignment);
   BtPointer Realloc(uint32 oldOffset, uint32 itemSize, uint32 itemAlignment);
-  void SortGaps();
+  BtPointer AddBlock(uint32 begin, uint32 size, uint32 alignment);
+  // Merges with adjacent gaps
+  void AddGap(uint32 begin, uint32 end);
+  void RemoveGap(std::pmr::map<uint32, uint32>::iterator gap);
   void NotifyDataMove(uint32 oldLoc, uint32 newLoc, uint32 oldLocSize);
   void AddPointer(int32 *ptr);
+  void SetLocalPointer(uint32 offset, uint32 pointsTo, uint32 size);
+  // At least by minSize, geometrically
+  void GrowData(uint32 minSize);
+
+  struct Arena {
+    // Index nodes and Build scratch
+    std::pmr::unsynchronized_pool_resource pool;
+    std::string data;
+  };
+
+  struct ArenaDeleter {
+    void operator()(Arena *item) const;
+  };
 
-  std::vector<Block> blocks;
-  std::vector<Gap> gaps{Gap{0, 0x2000}};
-  std::string data = std::string(size_t(0x2000), '\0');
-  std::vector<BtPointer *> pointers;
-  std::vector<LocalPointer> localPointers;
+  struct ArenaCache;
+  static Arena *AcquireArena();
+
+  std::unique_ptr<Arena, ArenaDeleter> arena;
+  std::string &data;
+  // Keyed by begin
+  std::pmr::map<uint32, Block> blocks;
+  uint32 numAllocations = 0;
+  // Free ranges {begin, end}, never adjacent to each other
+  std::pmr::map<uint32, uint32> gaps;
+  // {size, begin}, smallest fitting gap is taken first, lowest begin on ties
+  // Previous gap vector left ties to std::sort, which is not stable
+  std::pmr::set<std::pair<uint32, uint32>> gapSizes;
+  // Head of live BtPointer list
+  BtPointer *pointers = nullptr;
+  // Moved block ranges are resolved by offset in both directions
+  std::pmr::map<uint32, LocalPointer> localPointers;
+  // Map nodes are stable, so moving pointer does not touch its target entry
+  using LocalPointerEntry = decltype(localPointers)::value_type;
+  std::pmr::set<std::pair<uint32, LocalPointerEntry *>> pointerTargets;
 };
 } // namespace prime::utils
@@ -1,10 +1,12 @@
+#include "common/flat_hash_map.hpp"
 #include "common/resource.hpp"
 #include <functional>
 #include <map>
 
 namespace prime::common {
-extern std::map<ResourceHash, std::pair<std::string, ResourceData>> resources;
-std::map<uint32, ResourceHandle> &Registry();
+extern FlatHashMap<ResourceHash, std::pair<std::string, ResourceData>>
+    resources;
+FlatHashMap<uint32, ResourceHandle> &Registry();
 
 using IterFunc =
     std::function<void(std::string_view path, std::string_view className,
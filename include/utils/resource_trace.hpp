@@ -0,0 +1,63 @@
+#pragma once
+#include "common/resource_hash.hpp"
+#include <array>
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace prime::utils {
+enum class TraceStage : uint8 {
+  Load,    // Whole LoadResource call
+  Read,    // File or archive read, batched reads are recorded under class 0
+  Convert, // ConvertResource
+  Compile, // CompileScript
+  Process, // ResourceHandle::Process
+};
+
+constexpr size_t NUM_TRACE_STAGES = size_t(TraceStage::Process) + 1;
+
+struct StageStats {
+  uint64 numCalls = 0;
+  uint64 totalNs = 0;
+  uint64 maxNs = 0;
+};
+
+struct ResourceClassStats {
+  std::array<StageStats, NUM_TRACE_STAGES> stages{};
+  uint64 bytesRead = 0;
+  // LoadResource calls that found data already resident
+  uint64 numCacheHits = 0;
+};
+
+// Collected always, keyed by class hash
+std::map<uint32, ResourceClassStats> GetResourceStats();
+void ResetResourceStats();
+
+void RecordStage(common::ResourceHash hash, TraceStage stage,
+                 std::chrono::steady_clock::time_point begin,
+                 std::chrono::steady_clock::time_point end);
+void RecordBytesRead(uint32 classHash, size_t numBytes);
+void RecordCacheHit(uint32 classHash);
+
+// Measures scope lifetime
+class TraceScope {
+public:
+  TraceScope(common::ResourceHash hash_, TraceStage stage_)
+      : hash(hash_), stage(stage_), begin(std::chrono::steady_clock::now()) {}
+  TraceScope(const TraceScope &) = delete;
+  ~TraceScope() {
+    RecordStage(hash, stage, begin, std::chrono::steady_clock::now());
+  }
+
+private:
+  common::ResourceHash hash;
+  TraceStage stage;
+  std::chrono::steady_clock::time_point begin;
+};
+
+// Individual events are kept only while tracing is enabled
+void EnableResourceTrace(bool enable);
+// Writes events in Chrome trace event format (chrome://tracing, Perfetto)
+// and clears them
+bool DumpResourceTrace(const std::string &path);
+} // namespace prime::utils
@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+#include <string>
+
+namespace prime::utils {
+// Called concurrently from scan workers, worker is index of calling worker
+// in range [0, NumScanWorkers())
+// Callbacks must not throw
+using ScanCallback =
+    std::function<void(const std::string &path, size_t worker)>;
+
+size_t NumScanWorkers();
+
+// Recursively walks folder on worker pool and calling thread
+// Directories are shared among workers and read with getdents64
+// onFolder is called for every folder including root, onFile for every
+// other entry, paths are absolute
+// Folders named .prime are skipped
+void ScanTree(const std::string &root, const ScanCallback &onFolder,
+              const ScanCallback &onFile);
+
+// Same as above, with folder listings persisted in indexPath
+// Folders with unchanged mtime are not read, their entries come from index
+// Index is rewritten only when something changed
+void ScanTree(const std::string &root, const std::string &indexPath,
+              const ScanCallback &onFolder, const ScanCallback &onFile);
+} // namespace prime::utils
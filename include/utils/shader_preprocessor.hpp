@@ -7,8 +7,11 @@ struct DUI;
 }
 
 namespace prime::utils {
-std::string PreprocessShader(JenHash3 object, uint16 target,
-                             std::span<std::string_view> definitions);
-std::string PreProcess(common::ResourceHash object, simplecpp::DUI &dui);
+// ERROR_RESOURCE_NOT_FOUND when shader source is missing
+common::Return<std::string>
+PreprocessShader(JenHash3 object, uint16 target,
+                 std::span<std::string_view> definitions);
+common::Return<std::string> PreProcess(common::ResourceHash object,
+                                       simplecpp::DUI &dui);
 
 } // namespace prime::utils
@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+namespace prime::utils {
+// Lock-free ring buffer for single producer and single consumer thread
+template <class T, size_t N> class SpscQueue {
+  static_assert(std::has_single_bit(N), "Capacity must be power of 2");
+
+public:
+  // Returns false when queue is full
+  bool Push(const T &item) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+
+    if (t - head.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+
+    items[t % N] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false when queue is empty
+  bool Pop(T &item) {
+    const size_t h = head.load(std::memory_order_relaxed);
+
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = items[h % N];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, N> items;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+} // namespace prime::utils
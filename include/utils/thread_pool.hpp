@@ -0,0 +1,80 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace prime::utils {
+// Fixed set of workers executing tasks in FIFO order
+struct ThreadPool {
+  ThreadPool(size_t numThreads = std::thread::hardware_concurrency()) {
+    numThreads = std::max(numThreads, size_t(1));
+    workers.reserve(numThreads);
+
+    for (size_t i = 0; i < numThreads; i++) {
+      workers.emplace_back([this](std::stop_token stop) { Work(stop); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&) = delete;
+
+  ~ThreadPool() {
+    for (auto &w : workers) {
+      w.request_stop();
+    }
+
+    signal.notify_all();
+  }
+
+  template <class F> auto Enqueue(F &&func) {
+    using result_type = std::invoke_result_t<std::decay_t<F>>;
+    std::packaged_task<result_type()> task(std::forward<F>(func));
+    auto future = task.get_future();
+
+    {
+      std::lock_guard lg(mtx);
+      queue.emplace_back(std::move(task));
+    }
+
+    signal.notify_one();
+    return future;
+  }
+
+  size_t NumThreads() const { return workers.size(); }
+
+private:
+  std::mutex mtx;
+  std::condition_variable_any signal;
+  std::deque<std::move_only_function<void()>> queue;
+  std::vector<std::jthread> workers;
+
+  void Work(std::stop_token stop) {
+    while (true) {
+      std::move_only_function<void()> task;
+
+      {
+        std::unique_lock lk(mtx);
+        if (!signal.wait(lk, stop, [&] { return !queue.empty(); })) {
+          return;
+        }
+
+        task = std::move(queue.front());
+        queue.pop_front();
+      }
+
+      task();
+    }
+  }
+};
+
+// Process wide pool sized by hardware_concurrency
+inline ThreadPool &WorkerPool() {
+  static ThreadPool pool;
+  return pool;
+}
+} // namespace prime::utils
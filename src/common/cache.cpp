@@ -0,0 +1,389 @@
+#include "common/cache.hpp"
+#include "common/resource.hpp"
+#include "spike/crypto/crc32.hpp"
+#include "utils/debug.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include <zstd.h>
+
+namespace prime::common {
+namespace {
+struct MappedFile {
+  char *data = nullptr;
+  size_t size = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile(MappedFile &&o) : data(o.data), size(o.size) {
+    o.data = nullptr;
+    o.size = 0;
+  }
+  ~MappedFile() {
+    if (data) {
+      munmap(data, size);
+    }
+  }
+
+  ReturnStatus Map(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+      return RUNTIME_ERROR("Cannot open %s: %s", path.c_str(),
+                           strerror(errno));
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+      close(fd);
+      return RUNTIME_ERROR("Cannot map empty file %s", path.c_str());
+    }
+
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+      return RUNTIME_ERROR("Cannot map %s: %s", path.c_str(), strerror(errno));
+    }
+
+    data = static_cast<char *>(mapped);
+    size = st.st_size;
+    return NO_ERROR;
+  }
+};
+
+struct DDictDeleter {
+  void operator()(ZSTD_DDict *dict) const { ZSTD_freeDDict(dict); }
+};
+
+struct CacheArchive {
+  uint32 id;
+  MappedFile index;
+  MappedFile blob;
+  std::vector<std::unique_ptr<ZSTD_DDict, DDictDeleter>> dictionaries;
+
+  const Cache &Header() const {
+    return *reinterpret_cast<const Cache *>(index.data);
+  }
+
+  const CacheFile *Find(ResourceHash hash) const {
+    const Cache &hdr = Header();
+    auto found = std::lower_bound(
+        hdr.files.begin(), hdr.files.end(), hash,
+        [](const CacheFile &f, ResourceHash h) { return f.info < h; });
+
+    if (found == hdr.files.end() || found->info.hash != hash.hash) {
+      return nullptr;
+    }
+
+    return found;
+  }
+
+  ReturnStatus Read(const CacheFile &file, std::string &buffer) const;
+  ReturnStatus DecompressBlock(uint32 blockIndex, char *outData, size_t outSize,
+                               size_t &decompressed) const;
+};
+
+// Archives are consulted from the last mounted one, so patches can override
+std::vector<CacheArchive> ARCHIVES;
+// Stripped debug data, joined to resources read from ARCHIVES
+std::vector<CacheArchive> DEBUG_ARCHIVES;
+
+struct DCtxDeleter {
+  void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); }
+};
+
+ZSTD_DCtx *DecompressContext() {
+  thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> ctx(ZSTD_createDCtx());
+  return ctx.get();
+}
+
+// Partially read blocks are kept decompressed, small resources packed
+// together then cost one decompression per block
+struct BlockCache {
+  struct Entry {
+    uint64 key;
+    std::string data;
+  };
+
+  std::mutex mtx;
+  std::list<Entry> entries; // most recently used first
+  std::unordered_map<uint64, std::list<Entry>::iterator> lookup;
+  size_t budget = 0x1000000;
+  size_t usedBytes = 0;
+  uint64 numHits = 0;
+  uint64 numMisses = 0;
+
+  bool Copy(uint64 key, char *outData, size_t offset, size_t size) {
+    std::lock_guard lg(mtx);
+    auto found = lookup.find(key);
+
+    if (found == lookup.end()) {
+      numMisses++;
+      return false;
+    }
+
+    numHits++;
+    entries.splice(entries.begin(), entries, found->second);
+    memcpy(outData, found->second->data.data() + offset, size);
+    return true;
+  }
+
+  void Insert(uint64 key, std::string &&data) {
+    std::lock_guard lg(mtx);
+
+    // Budget is for real memory, not only used part of string
+    if (data.capacity() > budget || lookup.contains(key)) {
+      return;
+    }
+
+    usedBytes += data.capacity();
+    entries.emplace_front(Entry{key, std::move(data)});
+    lookup.emplace(key, entries.begin());
+    Evict();
+  }
+
+  void Evict() {
+    while (usedBytes > budget) {
+      usedBytes -= entries.back().data.capacity();
+      lookup.erase(entries.back().key);
+      entries.pop_back();
+    }
+  }
+};
+
+BlockCache &BLOCK_CACHE() {
+  static BlockCache cache;
+  return cache;
+}
+
+ReturnStatus CacheArchive::DecompressBlock(uint32 blockIndex, char *outData,
+                                           size_t outSize,
+                                           size_t &decompressed) const {
+  const Cache &hdr = Header();
+
+  if (blockIndex >= hdr.blocks.numItems) {
+    return RUNTIME_ERROR("Cache block %u out of range", blockIndex);
+  }
+
+  const CacheBlock &block = hdr.blocks[blockIndex];
+
+  if (block.offset + block.size > blob.size) {
+    return RUNTIME_ERROR("Cache block %u is truncated", blockIndex);
+  }
+
+  if (block.dictionary > dictionaries.size()) {
+    return RUNTIME_ERROR("Cache block %u has invalid dictionary", blockIndex);
+  }
+
+  if (block.dictionary) {
+    decompressed = ZSTD_decompress_usingDDict(
+        DecompressContext(), outData, outSize, blob.data + block.offset,
+        block.size, dictionaries[block.dictionary - 1].get());
+  } else {
+    decompressed = ZSTD_decompressDCtx(DecompressContext(), outData, outSize,
+                                       blob.data + block.offset, block.size);
+  }
+
+  if (ZSTD_isError(decompressed)) {
+    return RUNTIME_ERROR("Cannot decompress cache block %u: %s", blockIndex,
+                         ZSTD_getErrorName(decompressed));
+  }
+
+  return NO_ERROR;
+}
+
+ReturnStatus CacheArchive::Read(const CacheFile &file,
+                                std::string &buffer) const {
+  constexpr size_t BLOCK_SIZE = Cache::BLOCK_SIZE;
+  const uint64 begin = uint64(file.blockOffset) * BLOCK_SIZE + file.microOffset;
+  size_t remaining = size_t(file.numBlocks) * BLOCK_SIZE + file.tailSize;
+  buffer.resize(remaining);
+  char *outData = buffer.data();
+  BlockCache &blockCache = BLOCK_CACHE();
+
+  for (uint32 b = begin / BLOCK_SIZE; remaining > 0; b++) {
+    const size_t blockBegin = b == begin / BLOCK_SIZE ? begin % BLOCK_SIZE : 0;
+    const size_t numBytes = std::min(BLOCK_SIZE - blockBegin, remaining);
+    size_t dSize = 0;
+
+    // Whole block belongs to this resource, nothing else will need it
+    if (blockBegin == 0 && numBytes == BLOCK_SIZE) {
+      if (auto status = DecompressBlock(b, outData, numBytes, dSize); status) {
+        return status;
+      }
+
+      if (dSize != numBytes) {
+        return RUNTIME_ERROR("Cache block %u has invalid size", b);
+      }
+    } else {
+      const uint64 key = (uint64(id) << 32) | b;
+
+      if (!blockCache.Copy(key, outData, blockBegin, numBytes)) {
+        std::string block;
+        block.resize(BLOCK_SIZE);
+
+        if (auto status = DecompressBlock(b, block.data(), BLOCK_SIZE, dSize);
+            status) {
+          return status;
+        }
+
+        if (dSize < blockBegin + numBytes) {
+          return RUNTIME_ERROR("Cache block %u has invalid size", b);
+        }
+
+        block.resize(dSize);
+
+        // Last block of archive is usually partial
+        if (dSize < BLOCK_SIZE) {
+          block.shrink_to_fit();
+        }
+
+        memcpy(outData, block.data() + blockBegin, numBytes);
+        blockCache.Insert(key, std::move(block));
+      }
+    }
+
+    outData += numBytes;
+    remaining -= numBytes;
+  }
+
+  return NO_ERROR;
+}
+
+ReturnStatus MountArchive(const std::string &path,
+                          std::vector<CacheArchive> &archives) {
+  CacheArchive archive;
+  // Block cache keys must be unique across both lists
+  archive.id = ARCHIVES.size() + DEBUG_ARCHIVES.size();
+  std::string indexPath(path);
+  indexPath.push_back('.');
+  indexPath.append(GetClassExtension<Cache>());
+
+  if (auto status = archive.index.Map(indexPath); status) {
+    return status;
+  }
+
+  if (auto status = archive.blob.Map(path + ".dat"); status) {
+    return status;
+  }
+
+  if (archive.index.size < sizeof(Cache)) {
+    return RUNTIME_ERROR("Cache index %s is truncated", indexPath.c_str());
+  }
+
+  if (auto status = ValidateClass(archive.Header()); status) {
+    return status;
+  }
+
+  for (const CacheDictionary &dict : archive.Header().dictionaries) {
+    ZSTD_DDict *ddict = ZSTD_createDDict(dict.data.begin(), dict.data.numItems);
+
+    if (!ddict) {
+      return RUNTIME_ERROR("Cannot load dictionary for class 0x%X from %s",
+                           dict.classHash, indexPath.c_str());
+    }
+
+    archive.dictionaries.emplace_back(ddict);
+  }
+
+  archives.emplace_back(std::move(archive));
+  return NO_ERROR;
+}
+} // namespace
+
+Return<void> AddCacheArchive(const std::string &path) {
+  return {MountArchive(path, ARCHIVES)};
+}
+
+Return<void> AddCacheDebugArchive(const std::string &path) {
+  return {MountArchive(path + ".debug", DEBUG_ARCHIVES)};
+}
+
+namespace {
+ReturnStatus JoinDebug(ResourceHash hash, std::string &buffer) {
+  for (auto it = DEBUG_ARCHIVES.rbegin(); it != DEBUG_ARCHIVES.rend(); it++) {
+    const CacheFile *file = it->Find(hash);
+
+    if (!file) {
+      continue;
+    }
+
+    std::string debug;
+
+    if (auto status = it->Read(*file, debug); status) {
+      return status;
+    }
+
+    utils::ResourceDebugFooter footer;
+    CacheDebugTrailer trailer;
+
+    if (debug.size() < sizeof(footer) + sizeof(trailer)) {
+      return NO_ERROR;
+    }
+
+    memcpy(&trailer, debug.data() + debug.size() - sizeof(trailer),
+           sizeof(trailer));
+    debug.resize(debug.size() - sizeof(trailer));
+    memcpy(&footer, debug.data() + debug.size() - sizeof(footer),
+           sizeof(footer));
+
+    // Resource from patch archive might not match stripped data
+    if (footer.id == utils::ResourceDebugFooter::ID &&
+        footer.dataSize == buffer.size() &&
+        crc32b(0, buffer.data(), buffer.size()) == trailer.payloadCrc) {
+      buffer.append(debug);
+    }
+
+    return NO_ERROR;
+  }
+
+  return NO_ERROR;
+}
+} // namespace
+
+Return<void> ReadCacheResource(ResourceHash hash, std::string &buffer) {
+  for (auto it = ARCHIVES.rbegin(); it != ARCHIVES.rend(); it++) {
+    if (const CacheFile *file = it->Find(hash); file) {
+      if (auto status = it->Read(*file, buffer); status) {
+        return {status};
+      }
+
+      return {JoinDebug(hash, buffer)};
+    }
+  }
+
+  return {ERROR_KEY_NOT_FOUND_IN_MAP};
+}
+
+bool IsCachedResource(ResourceHash hash) {
+  return std::any_of(ARCHIVES.begin(), ARCHIVES.end(),
+                     [hash](const CacheArchive &a) { return a.Find(hash); });
+}
+
+void SetCacheBlockBudget(size_t numBytes) {
+  BlockCache &cache = BLOCK_CACHE();
+  std::lock_guard lg(cache.mtx);
+  cache.budget = numBytes;
+  cache.Evict();
+}
+
+CacheBlockStats GetCacheBlockStats() {
+  BlockCache &cache = BLOCK_CACHE();
+  std::lock_guard lg(cache.mtx);
+  return {
+      .numHits = cache.numHits,
+      .numMisses = cache.numMisses,
+      .usedBytes = cache.usedBytes,
+      .budget = cache.budget,
+  };
+}
+} // namespace prime::common
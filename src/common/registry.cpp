@@ -1,36 +1,126 @@
 #include "common/core.hpp"
+#include "common/perfect_hash_map.hpp"
+#include <atomic>
 #include <cstring>
 #include <map>
+#include <shared_mutex>
 #include <string_view>
 
+namespace {
+using namespace prime::common;
+
+// Built from classes registered during static initialization, late
+// registrations go into small fallback maps
+struct ClassTables {
+  PerfectHashMap<uint64, uint32> extToClass;
+  PerfectHashMap<uint32, ExtString> classToExt;
+};
+
+// Classes are registered from static initializers of many translation
+// units, so set of them cannot be known at compile time and tables are built
+// on first lookup instead
+std::atomic<const ClassTables *> TABLES;
+std::atomic_bool HAS_LATE_CLASSES;
+
+std::shared_mutex &RegistryMutex() {
+  static std::shared_mutex mtx;
+  return mtx;
+}
+
+auto &RegisteredClasses() {
+  static std::vector<std::pair<ExtString, uint32>> REGISTERED;
+  return REGISTERED;
+}
+
 auto &RegistryEH() {
-  static std::map<prime::common::ExtString, uint32> REGISTRY_EH;
+  static std::map<ExtString, uint32> REGISTRY_EH;
   return REGISTRY_EH;
 };
 
 auto &RegistryHE() {
-  static std::map<uint32, prime::common::ExtString> REGISTRY_HE;
+  static std::map<uint32, ExtString> REGISTRY_HE;
   return REGISTRY_HE;
 };
 
+const ClassTables &Tables() {
+  if (const ClassTables *tables = TABLES.load(std::memory_order_acquire)) {
+    return *tables;
+  }
+
+  std::lock_guard lg(RegistryMutex());
+
+  if (const ClassTables *tables = TABLES.load(std::memory_order_relaxed)) {
+    return *tables;
+  }
+
+  std::vector<std::pair<uint64, uint32>> extToClass;
+  std::vector<std::pair<uint32, ExtString>> classToExt;
+
+  for (auto &[ext, obj] : RegisteredClasses()) {
+    extToClass.emplace_back(ext.raw, obj);
+    classToExt.emplace_back(obj, ext);
+  }
+
+  // Lives until exit, lookups never take any lock afterwards
+  const ClassTables *tables = new ClassTables{
+      .extToClass = PerfectHashMap<uint64, uint32>(extToClass),
+      .classToExt = PerfectHashMap<uint32, ExtString>(classToExt),
+  };
+  TABLES.store(tables, std::memory_order_release);
+
+  return *tables;
+}
+} // namespace
+
 prime::common::Return<uint32> prime::common::GetClassFromExtension(std::string_view ext) {
   prime::common::ExtString key;
   memcpy(key.c, ext.data(), std::min(sizeof(key) - 1, ext.size()));
 
-  return MapGetOr(RegistryEH(), key, [&]{
-    common::RuntimeError("Cannot find extension %s in class registry.", ext.data());
-    return 0;
-  });
+  if (const uint32 *found = Tables().extToClass.find(key.raw)) {
+    return {NO_ERROR, *found};
+  }
+
+  if (HAS_LATE_CLASSES.load(std::memory_order_acquire)) {
+    std::shared_lock lk(RegistryMutex());
+
+    if (auto found = RegistryEH().find(key); found != RegistryEH().end()) {
+      return {NO_ERROR, found->second};
+    }
+  }
+
+  common::RuntimeError("Cannot find extension %.*s in class registry.",
+                       int(ext.size()), ext.data());
+  return {ERROR_KEY_NOT_FOUND_IN_MAP, 0};
 }
 
 std::string_view prime::common::GetExtentionFromHash(uint32 hash) {
+  // Points into table, which is never freed
+  if (const ExtString *found = Tables().classToExt.find(hash)) {
+    return *found;
+  }
+
+  std::shared_lock lk(RegistryMutex());
   return RegistryHE().at(hash);
 }
 
 uint32 prime::common::detail::RegisterClass(prime::common::ExtString ext,
                                             uint32 obj) {
-  RegistryEH().emplace(ext, obj);
-  RegistryHE().emplace(obj, ext);
+  std::lock_guard lg(RegistryMutex());
+
+  if (const ClassTables *tables = TABLES.load(std::memory_order_relaxed)) {
+    if (!tables->extToClass.find(ext.raw)) {
+      RegistryEH().emplace(ext, obj);
+    }
+
+    if (!tables->classToExt.find(obj)) {
+      RegistryHE().emplace(obj, ext);
+    }
+
+    HAS_LATE_CLASSES.store(true, std::memory_order_release);
+  } else {
+    RegisteredClasses().emplace_back(ext, obj);
+  }
+
   return obj;
 }
 
@@ -1,26 +1,109 @@
 #include "common/resource.hpp"
-#include "spike/io/binreader.hpp"
-#include "spike/io/directory_scanner.hpp"
+#include "common/cache.hpp"
+#include "common/flat_hash_map.hpp"
 #include "spike/io/fileinfo.hpp"
 #include "spike/io/stat.hpp"
 #include "spike/master_printer.hpp"
+#include "utils/batch_read.hpp"
 #include "utils/converters.hpp"
-#include <dirent.h>
+#include "utils/debug.hpp"
+#include "utils/resource_trace.hpp"
+#include "utils/scan_tree.hpp"
+#include "utils/spsc_queue.hpp"
+#include "utils/thread_pool.hpp"
+#include <algorithm>
+#include <future>
 #include <map>
+#include <mutex>
+#include <poll.h>
 #include <script/scriptapi.hpp>
+#include <shared_mutex>
 #include <sys/inotify.h>
+#include <sys/mman.h>
 #include <thread>
 
 namespace prime::common {
 std::vector<std::string> workingDirs;
 static std::map<uint32, std::string> watches;
-static std::map<uint32, std::vector<ResourcePath>> workDirFiles;
+static FlatHashMap<uint32, std::vector<ResourcePath>> workDirFiles;
 static std::string projectFolder;
 static std::string projectCacheFolder;
 
-static ResourceData LoadResource(const std::string &path) {
+ResourceBuffer &ResourceBuffer::operator=(ResourceBuffer &&other) {
+  if (this != &other) {
+    Unmap();
+    heap = std::move(other.heap);
+    mapped = std::exchange(other.mapped, nullptr);
+    mappedSize = std::exchange(other.mappedSize, 0);
+  }
+
+  return *this;
+}
+
+void ResourceBuffer::Unmap() {
+  if (mapped) {
+    munmap(mapped, mappedSize);
+    mapped = nullptr;
+    mappedSize = 0;
+  }
+}
+
+void ResourceBuffer::resize(size_t newSize) {
+  if (mapped) {
+    std::string copy(mapped, std::min(newSize, mappedSize));
+    Unmap();
+    heap = std::move(copy);
+  }
+
+  heap.resize(newSize);
+}
+
+int ResourceBuffer::Map(int fd, size_t fileSize) {
+  void *ptr =
+      mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+  if (ptr == MAP_FAILED) {
+    return errno;
+  }
+
+  Unmap();
+  heap = {};
+  mapped = static_cast<char *>(ptr);
+  mappedSize = fileSize;
+  return 0;
+}
+
+// Candidate locations of resource, project cache is preferred
+// Project cache files are replaced by rename (see utils::CommitCachePath), so
+// they can be mapped. Working folders are edited in place, they are read.
+static utils::ReadRequest ResourceRequest(const std::string &path,
+                                          ResourceBuffer &buffer) {
+  if (path.front() == '/') {
+    return {.paths = {path}, .buffer = &buffer};
+  }
+
+  utils::ReadRequest retVal{.paths = {projectCacheFolder + path},
+                            .buffer = &buffer,
+                            .numMappable = !projectCacheFolder.empty()};
+
+  for (auto &w : workingDirs) {
+    retVal.paths.emplace_back(w + path);
+  }
+
+  return retVal;
+}
+
+static void ThrowReadError(int error, const std::string &path) {
+  if (error == ENOENT) {
+    throw es::FileNotFoundError(path);
+  }
+
+  throw std::runtime_error("Cannot read " + path + ": " + strerror(error));
+}
+
+// Returns errno of failed read
+static int ReadResourceFile(const std::string &path, ResourceData &data) {
   AFileInfo fileInfo(path);
-  ResourceData data{};
   data.hash.name = JenkinsHash3_(fileInfo.GetFullPathNoExt());
   std::string_view ext = fileInfo.GetExtension();
   ext.remove_prefix(1);
@@ -29,41 +112,25 @@ static ResourceData LoadResource(const std::string &path) {
       .Success([&data](uint32 value) { data.hash.type = value; })
       .Unused();
 
-  auto Load = [&](const std::string &base) {
-    BinReader rd(path.front() == '/' ? path : base + path);
-    rd.ReadContainer(data.buffer, rd.GetSize());
-  };
-
-  bool found = false;
-
-  try {
-    Load(projectCacheFolder);
-    found = true;
-  } catch (const es::FileNotFoundError &) {
-    for (auto &w : workingDirs) {
-      try {
-        Load(w);
-        found = true;
-        break;
-      } catch (const es::FileNotFoundError &) {
-      }
-    }
-  }
-
-  if (!found) {
-    throw es::FileNotFoundError(path);
-  }
+  utils::ReadRequest request = ResourceRequest(path, data.buffer);
+  utils::BatchRead({&request, 1});
 
-  return data;
+  return request.error;
 }
 
-std::map<ResourceHash, std::pair<std::string, ResourceData>> resources;
-static std::map<const void *, ResourceData *> resourceFromPtr;
+FlatHashMap<ResourceHash, std::pair<std::string, ResourceData>> resources;
+using ResourceEntry = std::pair<std::string, ResourceData>;
+static FlatHashMap<const void *, ResourceData *> resourceFromPtr;
+// Guards resources, resourceFromPtr and workDirFiles
+static std::shared_mutex RESOURCES_MTX;
+// Converters and script compiler are not reentrant
+static std::mutex CONVERT_MTX;
 
 ResourceHash AddSimpleResource(std::string path, uint32 classHash) {
   ResourceHash hash{};
   hash.name = JenkinsHash3_(path);
   hash.type = classHash;
+  std::lock_guard lg(RESOURCES_MTX);
 
   if (resources.contains(hash)) {
     return hash;
@@ -80,6 +147,7 @@ ResourceHash AddSimpleResource(std::string path, uint32 classHash) {
 
 void AddSimpleResource(ResourceData &&resource) {
   ResourceHash key(resource.hash);
+  std::lock_guard lg(RESOURCES_MTX);
 
   auto [item, _] = resources.insert_or_assign(
       key, std::pair<std::string, ResourceData>{{}, std::move(resource)});
@@ -94,21 +162,25 @@ Return<void> RegisterResource(std::string path) {
   return GetClassFromExtension(finf.GetExtension().substr(1))
       .Success([&](uint32 value) {
         ResourceHash hash(name, value);
+        std::lock_guard lg(RESOURCES_MTX);
         resources.insert({hash, {path, {hash, {}}}});
       })
       .Void();
 }
 
 void FreeResource(ResourceData &resource) {
+  std::lock_guard lg(RESOURCES_MTX);
   resourceFromPtr.erase(resource.buffer.data());
   resources.erase(resource.hash);
 }
 
 ResourceData &FindResource(const void *address) {
+  std::shared_lock lk(RESOURCES_MTX);
   return *resourceFromPtr.at(address);
 }
 
 const ResourcePath &FindResource(ResourceHash hash) {
+  std::shared_lock lk(RESOURCES_MTX);
   auto &files = workDirFiles.at(hash.name);
 
   for (auto &f : files) {
@@ -120,93 +192,684 @@ const ResourcePath &FindResource(ResourceHash hash) {
   throw std::out_of_range("Resource not found in working directories.");
 }
 
-auto &Registry() {
-  static std::map<uint32, ResourceHandle> registry;
+FlatHashMap<uint32, ResourceHandle> &Registry() {
+  static FlatHashMap<uint32, ResourceHandle> registry;
   return registry;
 }
 
+// Handles are added during static initialization, function local so it is
+// constructed before first use from any translation unit
+static std::shared_mutex &RegistryMutex() {
+  static std::shared_mutex mtx;
+  return mtx;
+}
+
 bool AddResourceHandle(uint32 hash, ResourceHandle handle) {
+  std::lock_guard lg(RegistryMutex());
   return Registry().emplace(hash, handle).second;
 }
 
 void *GetResourceHandle(ResourceData &data) { return data.buffer.data(); }
 
 Return<const ResourceHandle *> GetClassHandle(uint32 classHash) {
+  std::shared_lock lk(RegistryMutex());
   return MapGetCPtrOr(Registry(), classHash, [classHash] {
     RUNTIME_ERROR("Cannot find class 0x%X in registry", classHash);
   });
 }
 
-ResourceData &LoadResource(ResourceHash hash, bool reload) {
-  auto found = resources.find(hash);
+static const ResourceHandle *FindHandle(uint32 classHash) {
+  std::shared_lock lk(RegistryMutex());
+  auto found = Registry().find(classHash);
+  return found == Registry().end() ? nullptr : &found->second;
+}
 
-  if (found == resources.end()) {
-    auto foundWork = workDirFiles.find(hash.name);
+// Find resource entry, converts or compiles resource if needed
+// Returns nullptr for unknown resource
+static ResourceEntry *FindResourceEntry(ResourceHash hash) {
+  std::vector<ResourcePath> candidates;
 
-    if (foundWork == workDirFiles.end()) {
-      throw es::FileNotFoundError();
+  {
+    std::shared_lock lk(RESOURCES_MTX);
+    if (auto found = resources.find(hash); found != resources.end()) {
+      return &found->second;
     }
 
-    bool foundExact = false;
-    ResourcePath nutVariant;
-    ResourcePath rawVariant;
+    if (auto foundWork = workDirFiles.find(hash.name);
+        foundWork != workDirFiles.end()) {
+      candidates = foundWork->second;
+    }
+  }
+
+  if (IsCachedResource(hash)) {
+    std::lock_guard lg(RESOURCES_MTX);
+    return &resources.insert({hash, {{}, {hash, {}}}}).first->second;
+  }
+
+  if (candidates.empty()) {
+    return nullptr;
+  }
 
-    for (auto &f : foundWork->second) {
-      if (f.hash.type == hash.type) {
-        resources.insert({hash, {f.localPath, {hash, {}}}});
-        foundExact = true;
+  bool foundExact = false;
+  ResourcePath nutVariant;
+
+  for (auto &f : candidates) {
+    if (f.hash.type == hash.type) {
+      std::lock_guard lg(RESOURCES_MTX);
+      resources.insert({hash, {f.localPath, {hash, {}}}});
+      foundExact = true;
+      break;
+    } else if (f.localPath.ends_with(".nut")) {
+      nutVariant = f;
+    } else {
+      ResourcePath rawVariant = f;
+      rawVariant.hash = hash;
+      std::lock_guard lg(CONVERT_MTX);
+      utils::TraceScope trace(hash, utils::TraceStage::Convert);
+      if (utils::ConvertResource(rawVariant)) {
+        PrintInfo("Converted: ", f.localPath);
         break;
-      } else if (f.localPath.ends_with(".nut")) {
-        nutVariant = f;
-      } else {
-        ResourcePath rawVariant = f;
-        rawVariant.hash = hash;
-        if (utils::ConvertResource(rawVariant)) {
-          PrintInfo("Converted: ", f.localPath);
-          break;
-        }
       }
     }
+  }
+
+  if (!foundExact) {
+    if (nutVariant.localPath.size() > 0) {
+      std::lock_guard lg(CONVERT_MTX);
+      utils::TraceScope trace(hash, utils::TraceStage::Compile);
+      script::CompileScript(nutVariant);
+    }
+  }
+
+  std::shared_lock lk(RESOURCES_MTX);
+  auto found = resources.find(hash);
+  return found == resources.end() ? nullptr : &found->second;
+}
+
+static ResourceEntry &LocateResource(ResourceHash hash) {
+  if (ResourceEntry *entry = FindResourceEntry(hash)) {
+    return *entry;
+  }
+
+  throw es::FileNotFoundError();
+}
+
+static bool IsResourceLoaded(const std::pair<std::string, ResourceData> &res) {
+  std::shared_lock lk(RESOURCES_MTX);
+  return !res.second.buffer.empty();
+}
+
+// Resource dependencies from ResourceDebug footers, filled when resource is
+// read
+static FlatHashMap<ResourceHash, std::vector<ResourceHash>> DEPENDENCIES;
+
+static std::vector<ResourceHash> ReadDependencies(ResourceBuffer &buffer) {
+  std::vector<ResourceHash> retVal;
+
+  if (buffer.size() < sizeof(utils::ResourceDebugFooter)) {
+    return retVal;
+  }
+
+  const utils::ResourceDebug *debug =
+      utils::LocateDebug(buffer.data(), buffer.size());
+
+  if (!debug) {
+    return retVal;
+  }
+
+  for (auto &d : debug->dependencies) {
+    const uint32 name = JenkinsHash3_(std::string_view(d.path));
+
+    for (uint32 type : d.types) {
+      retVal.emplace_back(name, type);
+    }
+  }
+
+  return retVal;
+}
+
+std::vector<ResourceHash> ResourceDependencies(ResourceHash hash) {
+  std::shared_lock lk(RESOURCES_MTX);
+  auto found = DEPENDENCIES.find(hash);
+  return found == DEPENDENCIES.end() ? std::vector<ResourceHash>{}
+                                     : found->second;
+}
+
+// Reverse of DEPENDENCIES plus links added by AddReloadDependency
+static FlatHashMap<ResourceHash, std::vector<ResourceHash>> DEPENDENTS;
+
+static void LinkDependent(ResourceHash dependency, ResourceHash dependent) {
+  auto &dependents = DEPENDENTS[dependency];
+
+  if (std::none_of(dependents.begin(), dependents.end(),
+                   [&](ResourceHash h) { return h.hash == dependent.hash; })) {
+    dependents.push_back(dependent);
+  }
+}
+
+static void UnlinkDependent(ResourceHash dependency, ResourceHash dependent) {
+  auto found = DEPENDENTS.find(dependency);
+
+  if (found == DEPENDENTS.end()) {
+    return;
+  }
+
+  std::erase_if(found->second,
+                [&](ResourceHash h) { return h.hash == dependent.hash; });
+
+  if (found->second.empty()) {
+    DEPENDENTS.erase(dependency);
+  }
+}
+
+void AddReloadDependency(ResourceHash dependency, ResourceHash dependent) {
+  std::lock_guard lg(RESOURCES_MTX);
+  LinkDependent(dependency, dependent);
+}
+
+// Source of ResourceData::lastUse
+static std::atomic<uint64> USE_TICK;
+
+static void StoreResource(std::pair<std::string, ResourceData> &res,
+                          ResourceData &&loaded, bool reload) {
+  utils::RecordBytesRead(loaded.hash.type, loaded.buffer.size());
+  auto dependencies = ReadDependencies(loaded.buffer);
+  std::lock_guard lg(RESOURCES_MTX);
+
+  // Loaded concurrently by other thread
+  if (!res.second.buffer.empty() && !reload) {
+    return;
+  }
+
+  if (auto found = DEPENDENCIES.find(loaded.hash);
+      found != DEPENDENCIES.end()) {
+    for (ResourceHash d : found->second) {
+      UnlinkDependent(d, loaded.hash);
+    }
+  }
+
+  for (ResourceHash d : dependencies) {
+    LinkDependent(d, loaded.hash);
+  }
+
+  if (dependencies.empty()) {
+    DEPENDENCIES.erase(loaded.hash);
+  } else {
+    DEPENDENCIES.insert_or_assign(loaded.hash, std::move(dependencies));
+  }
+
+  if (reload) {
+    resourceFromPtr.erase(res.second.buffer.data());
+    res.second = std::move(loaded);
+  } else {
+    res.second.buffer = std::move(loaded.buffer);
+  }
+
+  resourceFromPtr.emplace(res.second.buffer.data(), &res.second);
+  // Not processed yet, must not be evicted before its owner gets to it
+  std::atomic_ref(res.second.lastUse).store(++USE_TICK,
+                                            std::memory_order_relaxed);
+}
+
+// Returns false when indexed file no longer exists
+static bool TryReadResource(ResourceEntry &res, bool reload) {
+  if (!reload && IsResourceLoaded(res)) {
+    return true;
+  }
+
+  const ResourceHash hash = res.second.hash;
+  utils::TraceScope trace(hash, utils::TraceStage::Read);
+  ResourceData loaded{};
+  loaded.hash = hash;
+
+  if (res.first.empty()) {
+    std::string buffer;
+    if (ReadCacheResource(hash, buffer).status) {
+      throw std::runtime_error("Cannot read archived resource.");
+    }
+
+    loaded.buffer = std::move(buffer);
+  } else if (const int error = ReadResourceFile(res.first, loaded); error) {
+    if (error == ENOENT) {
+      return false;
+    }
+
+    ThrowReadError(error, res.first);
+  }
+
+  StoreResource(res, std::move(loaded), reload);
+  return true;
+}
+
+static void ReadResource(ResourceEntry &res, bool reload) {
+  if (!TryReadResource(res, reload)) {
+    throw es::FileNotFoundError(res.first);
+  }
+}
+
+static void ProcessResource(ResourceData &res) {
+  std::atomic_ref(res.lastUse).store(++USE_TICK, std::memory_order_relaxed);
+
+  if (res.isProcessed) {
+    return;
+  }
+
+  if (const ResourceHandle *hdl = FindHandle(res.hash.type);
+      hdl && hdl->Process) {
+    utils::TraceScope trace(res.hash, utils::TraceStage::Process);
+    hdl->Process(res);
+  }
+
+  res.isProcessed = true;
+}
+
+// Reads entries that are not loaded yet in single batch
+// Archived resources are decompressed on worker pool meanwhile
+// Failed entries are skipped if throwOnError is false
+static void ReadResources(std::span<ResourceEntry *> entries,
+                          bool throwOnError) {
+  std::vector<ResourceData> loaded(entries.size());
+  std::vector<bool> toStore(entries.size());
+  std::vector<utils::ReadRequest> requests;
+  std::vector<size_t> requestEntries;
+  std::vector<std::future<bool>> archived;
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    auto &[fileName, resource] = *entries[i];
+
+    if (IsResourceLoaded(*entries[i])) {
+      continue;
+    }
+
+    loaded[i].hash = resource.hash;
+    toStore[i] = true;
+
+    if (fileName.empty()) {
+      archived.emplace_back(
+          utils::WorkerPool().Enqueue([&item = loaded[i]] {
+            std::string buffer;
+            if (ReadCacheResource(item.hash, buffer).status) {
+              return false;
+            }
+
+            item.buffer = std::move(buffer);
+            return true;
+          }));
+      continue;
+    }
+
+    requests.push_back(ResourceRequest(fileName, loaded[i].buffer));
+    requestEntries.push_back(i);
+  }
+
+  if (requests.empty() && archived.empty()) {
+    return;
+  }
+
+  utils::TraceScope trace(ResourceHash(0, 0), utils::TraceStage::Read);
+  utils::BatchRead(requests);
+  bool archiveFailed = false;
+
+  for (auto &a : archived) {
+    archiveFailed |= !a.get();
+  }
+
+  if (throwOnError) {
+    if (archiveFailed) {
+      throw std::runtime_error("Cannot read archived resource.");
+    }
 
-    if (!foundExact) {
-      if (nutVariant.localPath.size() > 0) {
-        script::CompileScript(nutVariant);
+    for (size_t r = 0; r < requests.size(); r++) {
+      if (requests[r].error) {
+        ThrowReadError(requests[r].error, entries[requestEntries[r]]->first);
       }
     }
+  }
 
-    int t = 0;
+  for (size_t r = 0; r < requests.size(); r++) {
+    if (requests[r].error) {
+      toStore[requestEntries[r]] = false;
+    }
   }
 
-  auto &res = resources.at(hash);
-  auto &[fileName, resource] = res;
+  for (size_t i = 0; i < entries.size(); i++) {
+    // Failed archive reads are left empty
+    if (toStore[i] && !loaded[i].buffer.empty()) {
+      StoreResource(*entries[i], std::move(loaded[i]), false);
+    }
+  }
+}
+
+// Reads whole dependency tree ahead of LinkResource chain, one batch per
+// tree level
+// Missing dependencies are left for LinkResource to report
+static void PrefetchDependencies(ResourceHash root) {
+  std::vector<ResourceHash> level = ResourceDependencies(root);
+  FlatHashMap<ResourceHash, bool> visited;
+
+  while (!level.empty()) {
+    std::vector<ResourceEntry *> entries;
+
+    for (ResourceHash h : level) {
+      if (!visited.try_emplace(h, true).second) {
+        continue;
+      }
+
+      try {
+        if (ResourceEntry *entry = FindResourceEntry(h)) {
+          entries.push_back(entry);
+        }
+      } catch (const std::exception &) {
+        // Failed conversion, resource is reported when it is loaded directly
+      }
+    }
 
-  if (resource.buffer.empty() || reload) {
-    res.second = LoadResource(fileName);
-    resourceFromPtr.emplace(resource.buffer.data(), &res.second);
+    ReadResources(entries, false);
+    level.clear();
+
+    for (auto e : entries) {
+      auto deps = ResourceDependencies(e->second.hash);
+      level.insert(level.end(), deps.begin(), deps.end());
+    }
   }
+}
 
-  if (Registry().contains(hash.type)) {
-    if (res.second.numRefs == 0) {
-      Registry().at(hash.type).Process(res.second);
+Return<ResourceData *> TryLoadResource(ResourceHash hash, bool reload) {
+  utils::TraceScope trace(hash, utils::TraceStage::Load);
+  ResourceEntry *res = FindResourceEntry(hash);
+
+  if (!res) {
+    return {ERROR_RESOURCE_NOT_FOUND};
+  }
+
+  const bool wasLoaded = IsResourceLoaded(*res);
+
+  if (wasLoaded && !reload) {
+    utils::RecordCacheHit(hash.type);
+  }
+
+  if (!TryReadResource(*res, reload)) {
+    return {ERROR_RESOURCE_NOT_FOUND};
+  }
+
+  if (!wasLoaded) {
+    PrefetchDependencies(hash);
+  }
+
+  ProcessResource(res->second);
+  return {NO_ERROR, &res->second};
+}
+
+ResourceData &LoadResource(ResourceHash hash, bool reload) {
+  auto loaded = TryLoadResource(hash, reload);
+
+  if (loaded.status) {
+    throw es::FileNotFoundError();
+  }
+
+  return *loaded.retVal;
+}
+
+std::vector<ResourceData *>
+LoadResources(std::span<const ResourceHash> hashes) {
+  std::vector<ResourceEntry *> entries;
+  entries.reserve(hashes.size());
+
+  for (ResourceHash h : hashes) {
+    entries.push_back(&LocateResource(h));
+  }
+
+  ReadResources(entries, true);
+  std::vector<ResourceData *> retVal;
+  retVal.reserve(entries.size());
+
+  for (auto e : entries) {
+    ProcessResource(e->second);
+    retVal.push_back(&e->second);
+  }
+
+  return retVal;
+}
+
+namespace {
+struct LoadedResource {
+  std::thread::id owner;
+  ResourceHash hash;
+  ResourceData *data = nullptr;
+  std::exception_ptr error;
+  std::promise<ResourceData *> promise;
+};
+
+std::mutex ASYNC_MTX;
+std::vector<LoadedResource> LOADED;
+FlatHashMap<ResourceHash, std::shared_future<ResourceData *>> PENDING;
+} // namespace
+
+std::shared_future<ResourceData *> AsyncLoadResource(ResourceHash hash) {
+  std::lock_guard lg(ASYNC_MTX);
+
+  if (auto found = PENDING.find(hash); found != PENDING.end()) {
+    return found->second;
+  }
+
+  LoadedResource item;
+  item.owner = std::this_thread::get_id();
+  item.hash = hash;
+  auto future = item.promise.get_future().share();
+  PENDING.emplace(hash, future);
+
+  utils::WorkerPool().Enqueue([item = std::move(item)]() mutable {
+    try {
+      auto &res = LocateResource(item.hash);
+      ReadResource(res, false);
+      item.data = &res.second;
+    } catch (...) {
+      item.error = std::current_exception();
+    }
+
+    std::lock_guard lg(ASYNC_MTX);
+    LOADED.emplace_back(std::move(item));
+  });
+
+  return future;
+}
+
+void ProcessLoadedResources() {
+  std::vector<LoadedResource> ready;
+
+  {
+    std::lock_guard lg(ASYNC_MTX);
+    auto owned = std::stable_partition(
+        LOADED.begin(), LOADED.end(), [id = std::this_thread::get_id()](
+                                          const LoadedResource &item) {
+          return item.owner != id;
+        });
+    std::move(owned, LOADED.end(), std::back_inserter(ready));
+    LOADED.erase(owned, LOADED.end());
+
+    for (auto &item : ready) {
+      PENDING.erase(item.hash);
     }
   }
 
-  return res.second;
+  for (auto &item : ready) {
+    if (item.error) {
+      item.promise.set_exception(item.error);
+      continue;
+    }
+
+    try {
+      ProcessResource(*item.data);
+      item.promise.set_value(item.data);
+    } catch (...) {
+      item.promise.set_exception(std::current_exception());
+    }
+  }
 }
 
 void UnlinkResource(ResourceBase *ptr) {
   auto &foundRes = FindResource(ptr);
   foundRes.numRefs--;
 
-  if (foundRes.numRefs < 1) {
-    if (Registry().contains(foundRes.hash.type)) {
-      Registry().at(foundRes.hash.type).Delete(foundRes);
+  if (foundRes.numRefs < 1 && foundRes.isProcessed) {
+    if (const ResourceHandle *hdl = FindHandle(foundRes.hash.type);
+        hdl && hdl->Delete) {
+      hdl->Delete(foundRes);
+      foundRes.isProcessed = false;
+    }
+  }
+}
+
+static std::atomic_size_t RESIDENCY_BUDGET = 0x20000000;
+static std::atomic_size_t NUM_EVICTIONS = 0;
+// USE_TICK at previous TrimResources, resources used after it are pinned
+static std::atomic<uint64> TRIM_TICK = 0;
+static constexpr auto TRIM_PERIOD = std::chrono::milliseconds(250);
+
+void SetResidencyBudget(size_t bytes) { RESIDENCY_BUDGET = bytes; }
+
+ResidencyStats GetResidencyStats() {
+  ResidencyStats retVal;
+  retVal.budget = RESIDENCY_BUDGET;
+  retVal.numEvictions = NUM_EVICTIONS;
+  std::shared_lock lk(RESOURCES_MTX);
+
+  for (auto &[hash, res] : resources) {
+    if (const size_t size = res.second.buffer.size(); size > 0) {
+      retVal.usedBytes += size;
+      retVal.classBytes[hash.type] += size;
+    }
+  }
+
+  return retVal;
+}
+
+// Processed data may be referenced by whatever Process registered them to,
+// only Delete can tell it to let go
+static bool IsEvictable(const ResourceData &res) {
+  if (res.numRefs > 0 || res.buffer.empty()) {
+    return false;
+  }
+
+  if (!res.isProcessed) {
+    return true;
+  }
+
+  const ResourceHandle *hdl = FindHandle(res.hash.type);
+  return !hdl || !hdl->Process || hdl->Delete;
+}
+
+// Entry stays in resources, so resource is read again on next load
+// Delete runs without lock, it may call back into resource module
+static bool EvictResource(ResourceHash hash, uint64 pinnedFrom) {
+  ResourceData *data = nullptr;
+  const char *bufferData = nullptr;
+  uint64 lastUse = 0;
+  const ResourceHandle *deleteHdl = nullptr;
+
+  {
+    std::lock_guard lg(RESOURCES_MTX);
+    auto found = resources.find(hash);
+
+    if (found == resources.end() || !IsEvictable(found->second.second)) {
+      return false;
+    }
+
+    data = &found->second.second;
+    lastUse = std::atomic_ref(data->lastUse).load(std::memory_order_relaxed);
+
+    if (lastUse > pinnedFrom) {
+      return false;
+    }
+
+    bufferData = data->buffer.data();
+
+    // Cleared before Delete, load that comes meanwhile processes it again
+    if (data->isProcessed) {
+      data->isProcessed = false;
+
+      if (const ResourceHandle *hdl = FindHandle(hash.type);
+          hdl && hdl->Delete) {
+        deleteHdl = hdl;
+      }
+    }
+  }
+
+  if (deleteHdl) {
+    deleteHdl->Delete(*data);
+  }
+
+  std::lock_guard lg(RESOURCES_MTX);
+
+  // Delete handle freed resource by itself
+  if (auto found = resources.find(hash); found != resources.end()) {
+    ResourceData &res = found->second.second;
+
+    // Linked, reloaded or loaded while Delete ran, data stays and is
+    // processed again on next load
+    if (!IsEvictable(res) || res.buffer.data() != bufferData ||
+        std::atomic_ref(res.lastUse).load(std::memory_order_relaxed) !=
+            lastUse) {
+      return false;
+    }
+
+    resourceFromPtr.erase(res.buffer.data());
+    res.buffer = ResourceBuffer{};
+  }
+
+  NUM_EVICTIONS++;
+  return true;
+}
+
+void TrimResources() {
+  struct Candidate {
+    ResourceHash hash;
+    size_t size;
+    uint64 lastUse;
+  };
+
+  std::vector<Candidate> candidates;
+  size_t usedBytes = 0;
+  const uint64 pinnedFrom = TRIM_TICK.exchange(USE_TICK);
+
+  {
+    std::shared_lock lk(RESOURCES_MTX);
+
+    for (auto &[hash, res] : resources) {
+      usedBytes += res.second.buffer.size();
+
+      if (IsEvictable(res.second)) {
+        candidates.push_back({hash, res.second.buffer.size(),
+                              std::atomic_ref(res.second.lastUse).load(
+                                  std::memory_order_relaxed)});
+      }
+    }
+  }
+
+  const size_t budget = RESIDENCY_BUDGET;
+
+  if (usedBytes <= budget) {
+    return;
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.lastUse < b.lastUse;
+            });
+
+  for (auto &c : candidates) {
+    if (usedBytes <= budget) {
+      break;
+    }
+
+    if (EvictResource(c.hash, pinnedFrom)) {
+      usedBytes -= c.size;
     }
   }
 }
 
 static int INOTIFY = [] {
-  const int watchFd = inotify_init1(IN_NONBLOCK);
+  const int watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
   if (watchFd < 0) {
     PrintWarning("Failed to add watch: ", strerror(errno));
   }
@@ -214,127 +877,275 @@ static int INOTIFY = [] {
   return watchFd;
 }();
 
-static std::vector<ResourceHash> UPDATES;
-static char buffer[0x1000] alignas(16);
+// Guards watches and workingDirs against WATCHER thread
+static std::mutex WATCH_MTX;
+// Editors tend to write single file multiple times in a row
+static constexpr auto UPDATE_DEBOUNCE = std::chrono::milliseconds(50);
+struct ChangedResource {
+  ResourceHash hash;
+  // Last write to file
+  std::chrono::steady_clock::time_point time;
+};
+static utils::SpscQueue<ChangedResource, 1024> UPDATES;
+
+static ResourceHash HashFromWatchPath(std::string_view watchPath) {
+  const size_t foundDot = watchPath.find_last_of('.');
+
+  if (foundDot == watchPath.npos) {
+    return ResourceHash(JenkinsHash3_(watchPath), 0);
+  }
 
-void PollUpdates() {
-  const ssize_t rdLen = read(INOTIFY, buffer, sizeof(buffer));
-
-  for (ssize_t cb = 0; cb < rdLen;) {
-    const inotify_event *event =
-        reinterpret_cast<const inotify_event *>(buffer + cb);
-    cb += event->len + sizeof(inotify_event);
-
-    std::string watchPath = watches.at(event->wd) + '/' + event->name;
-
-    for (auto &w : workingDirs) {
-      if (watchPath.starts_with(w)) {
-        watchPath.erase(0, w.size());
-        const size_t foundDot = watchPath.find_last_of('.');
-        static const auto &reg = Registry();
-
-        if (foundDot != watchPath.npos) {
-          GetClassFromExtension(watchPath.substr(foundDot + 1))
-              .Either(
-                  [&](uint32 value) {
-                    if (reg.contains(value)) {
-                      const ResourceHandle &hdl = reg.at(value);
-                      if (hdl.Update) {
-                        hdl.Update(ResourceHash(
-                            JenkinsHash3_(watchPath.substr(0, foundDot)),
-                            value));
-                      }
-                      return;
-                    }
-
-                    for (auto &[c, hdl] : reg) {
-                      if (hdl.Update) {
-                        hdl.Update(ResourceHash(
-                            JenkinsHash3_(watchPath.substr(0, foundDot)),
-                            value));
-                      }
-                    }
-                  },
-                  [&] {
-                    for (auto &[c, hdl] : reg) {
-                      if (hdl.Update) {
-                        hdl.Update(ResourceHash(JenkinsHash3_(watchPath), 0));
-                      }
-                    }
-                  })
-              .Unused();
-        } else {
-          for (auto &[c, hdl] : reg) {
-            if (hdl.Update) {
-              hdl.Update(ResourceHash(
-                  JenkinsHash3_(watchPath.substr(0, foundDot)), 0));
-            }
-          }
-        }
+  return GetClassFromExtension(watchPath.substr(foundDot + 1))
+      .Either(
+          [&](uint32 value) {
+            return ResourceHash(JenkinsHash3_(watchPath.substr(0, foundDot)),
+                                value);
+          },
+          [&] { return ResourceHash(JenkinsHash3_(watchPath), 0); })
+      .retVal;
+}
 
-        break;
+static void ReadWatchEvents(
+    FlatHashMap<ResourceHash, std::chrono::steady_clock::time_point> &pending) {
+  alignas(inotify_event) char buffer[0x1000];
+  const auto now = std::chrono::steady_clock::now();
+
+  for (ssize_t rdLen; (rdLen = read(INOTIFY, buffer, sizeof(buffer))) > 0;) {
+    std::lock_guard lg(WATCH_MTX);
+
+    for (ssize_t cb = 0; cb < rdLen;) {
+      const inotify_event *event =
+          reinterpret_cast<const inotify_event *>(buffer + cb);
+      cb += event->len + sizeof(inotify_event);
+
+      auto foundWatch = watches.find(event->wd);
+
+      if (foundWatch == watches.end()) {
+        continue;
       }
-    }
 
-    int t = 0;
+      std::string watchPath = foundWatch->second + '/' + event->name;
+
+      for (auto &w : workingDirs) {
+        if (watchPath.starts_with(w)) {
+          pending.insert_or_assign(
+              HashFromWatchPath(std::string_view(watchPath).substr(w.size())),
+              now);
+          break;
+        }
+      }
+    }
   }
-  std::this_thread::sleep_for(std::chrono::milliseconds(2));
 }
-/*
+
+// Collects inotify events and hands them to PollUpdates once path settled
+// down for UPDATE_DEBOUNCE
 static std::jthread WATCHER([](std::stop_token stop_token) {
+  FlatHashMap<ResourceHash, std::chrono::steady_clock::time_point> pending;
+  std::vector<ChangedResource> settled;
+  pollfd pfd{.fd = INOTIFY, .events = POLLIN, .revents = 0};
+
   while (!stop_token.stop_requested()) {
+    // Wake up periodically to observe stop request
+    const int timeout = pending.empty() ? 100 : UPDATE_DEBOUNCE.count() / 2;
+
+    if (poll(&pfd, 1, timeout) > 0) {
+      ReadWatchEvents(pending);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    settled.clear();
+
+    for (auto &[hash, time] : pending) {
+      if (now - time >= UPDATE_DEBOUNCE) {
+        settled.push_back({hash, time});
+      }
+    }
+
+    for (auto &changed : settled) {
+      // Queue is full, try again on next wake up
+      if (!UPDATES.Push(changed)) {
+        break;
+      }
+
+      pending.erase(changed.hash);
+    }
   }
-});*/
+});
 
-void WatchTree(const std::string &path, std::string_view workDir) {
-  int watchFd = inotify_add_watch(INOTIFY, path.c_str(), IN_CLOSE_WRITE);
-  if (watchFd < 0) {
-    PrintWarning("Failed to create watch for ", path, " ", strerror(errno));
-  } else {
-    watches[watchFd] = path;
+// Post order walk, dependents are stored before their dependencies
+static void CollectDependents(ResourceHash hash,
+                              FlatHashMap<ResourceHash, bool> &visited,
+                              std::vector<ResourceHash> &order) {
+  if (!visited.try_emplace(hash, true).second) {
+    return;
   }
 
-  DIR *cDir = opendir(path.c_str());
+  if (auto found = DEPENDENTS.find(hash); found != DEPENDENTS.end()) {
+    for (ResourceHash d : found->second) {
+      CollectDependents(d, visited, order);
+    }
+  }
 
-  if (!cDir) {
+  order.push_back(hash);
+}
+
+// Resources without handle are plain data (shader sources, text), they are
+// reloaded here so dependents can pick up new data in their Update
+// Handled resources reload themselves in Update
+static void ReloadPlainResource(ResourceHash hash) {
+  if (FindHandle(hash.type)) {
     return;
   }
 
-  dirent *cFile = nullptr;
+  if (hash.type == 0) {
+    hash.type = GetClassHash<char>();
+  }
 
-  while ((cFile = readdir(cDir)) != nullptr) {
-    if (!strcmp(cFile->d_name, ".") || !strcmp(cFile->d_name, "..") ||
-        !strcmp(cFile->d_name, ".prime")) {
-      continue;
+  bool isLoaded = false;
+
+  {
+    std::shared_lock lk(RESOURCES_MTX);
+    auto found = resources.find(hash);
+    isLoaded = found != resources.end() && !found->second.second.buffer.empty();
+  }
+
+  if (isLoaded) {
+    LoadResource(hash, true);
+  }
+}
+
+// Updates changed resource and everything that transitively depends on it
+// Returns number of updated resources
+static size_t DispatchUpdate(ResourceHash hash) {
+  FlatHashMap<ResourceHash, bool> visited;
+  std::vector<ResourceHash> order;
+
+  {
+    std::shared_lock lk(RESOURCES_MTX);
+    CollectDependents(hash, visited, order);
+  }
+
+  ReloadPlainResource(hash);
+  size_t numUpdated = 0;
+
+  // Dependencies first, so dependents see already updated data
+  for (auto it = order.rbegin(); it != order.rend(); it++) {
+    if (const ResourceHandle *hdl = FindHandle(it->type);
+        hdl && hdl->Update) {
+      hdl->Update(*it);
+      numUpdated++;
     }
+  }
+
+  return numUpdated;
+}
 
-    std::string absPath(path + '/' + cFile->d_name);
+void PollUpdates() {
+  ProcessLoadedResources();
+
+  for (ChangedResource changed; UPDATES.Pop(changed);) {
+    const size_t numUpdated = DispatchUpdate(changed.hash);
 
-    if (cFile->d_type == DT_DIR) {
-      WatchTree(absPath, workDir);
+    if (numUpdated > 0) {
+      const std::chrono::duration<double, std::milli> latency =
+          std::chrono::steady_clock::now() - changed.time;
+      PrintInfo("Updated ", numUpdated, " resources in ", latency.count(),
+                "ms");
+    }
+  }
+
+  // Deferred, so resources used during frame stay valid until its end
+  static auto lastTrim = std::chrono::steady_clock::now();
+
+  if (const auto now = std::chrono::steady_clock::now();
+      now - lastTrim >= TRIM_PERIOD) {
+    lastTrim = now;
+    TrimResources();
+  }
+}
+
+void WatchTree(const std::string &path, std::string_view workDir) {
+  const size_t numWorkers = utils::NumScanWorkers();
+  std::vector<std::vector<std::pair<int, std::string>>> newWatches(numWorkers);
+  std::vector<std::vector<ResourcePath>> newFiles(numWorkers);
+  // Avoids registry lookup and its error message for every file
+  std::vector<std::map<std::string, uint32, std::less<>>> extTypes(numWorkers);
+
+  auto onFolder = [&](const std::string &folder, size_t worker) {
+    const int watchFd =
+        inotify_add_watch(INOTIFY, folder.c_str(), IN_CLOSE_WRITE);
+
+    if (watchFd < 0) {
+      PrintWarning("Failed to create watch for ", folder, " ", strerror(errno));
     } else {
-      std::string localPath = absPath.substr(workDir.size());
-      // PrintInfo(localPath);
-      AFileInfo finf(localPath);
-      const uint32 hash = JenkinsHash3_(finf.GetFullPathNoExt());
-      std::string_view ext(finf.GetExtension());
-      const uint32 type =
-          ext.empty() ? 0 : GetClassFromExtension(ext.substr(1)).retVal;
-      ResourcePath resPath{
-          .hash = ResourceHash(hash, type),
-          .localPath = localPath,
-          .workingDir = workDir,
-      };
+      newWatches[worker].emplace_back(watchFd, folder);
+    }
+  };
+  auto onFile = [&](const std::string &absPath, size_t worker) {
+    std::string localPath = absPath.substr(workDir.size());
+    AFileInfo finf(localPath);
+    const uint32 hash = JenkinsHash3_(finf.GetFullPathNoExt());
+    std::string_view ext(finf.GetExtension());
+    uint32 type = 0;
+
+    if (!ext.empty()) {
+      ext.remove_prefix(1);
+      auto &types = extTypes[worker];
+      auto found = types.find(ext);
+
+      if (found == types.end()) {
+        found =
+            types.emplace(std::string(ext), GetClassFromExtension(ext).retVal)
+                .first;
+      }
 
-      workDirFiles[hash].emplace_back(resPath);
+      type = found->second;
     }
+
+    newFiles[worker].push_back(ResourcePath{
+        .hash = ResourceHash(hash, type),
+        .localPath = std::move(localPath),
+        .workingDir = workDir,
+    });
+  };
+
+  // Index lives in project folder keyed by root, working folders are not
+  // touched, folders added before ProjectDataFolder are scanned without it
+  if (projectFolder.empty()) {
+    utils::ScanTree(path, onFolder, onFile);
+  } else {
+    char indexName[32];
+    snprintf(indexName, sizeof(indexName), "tree_index_%08X",
+             JenkinsHash3_(path));
+    utils::ScanTree(path, projectFolder + indexName, onFolder, onFile);
   }
 
-  closedir(cDir);
+  {
+    std::lock_guard lg(WATCH_MTX);
+
+    for (auto &w : newWatches) {
+      for (auto &[watchFd, folder] : w) {
+        watches[watchFd] = std::move(folder);
+      }
+    }
+  }
+
+  std::lock_guard lg(RESOURCES_MTX);
+
+  for (auto &f : newFiles) {
+    for (auto &resPath : f) {
+      workDirFiles[resPath.hash.name].emplace_back(std::move(resPath));
+    }
+  }
 }
 
 void AddWorkingFolder(std::string path) {
-  workingDirs.emplace_back(path);
+  {
+    std::lock_guard lg(WATCH_MTX);
+    workingDirs.emplace_back(path);
+  }
+
   while (path.size() && path.back() == '/') {
     path.pop_back();
   }
@@ -342,7 +1153,7 @@ void AddWorkingFolder(std::string path) {
 }
 
 void ProjectDataFolder(std::string_view path) {
-  AddWorkingFolder(std::string(path));
+  std::string workDir(path);
 
   while (path.back() == '/') {
     path.remove_suffix(1);
@@ -354,24 +1165,42 @@ void ProjectDataFolder(std::string_view path) {
   projectCacheFolder = projectFolder;
   projectCacheFolder.append("cache/");
   es::mkdir(projectCacheFolder);
+  // After projectFolder, so its tree index is stored there
+  AddWorkingFolder(std::move(workDir));
+
+  const size_t numWorkers = utils::NumScanWorkers();
+  std::vector<std::vector<std::pair<ResourceHash, std::string>>> cachedFiles(
+      numWorkers);
+
+  utils::ScanTree(
+      projectCacheFolder.substr(0, projectCacheFolder.size() - 1),
+      projectFolder + "cache_index", [](const std::string &, size_t) {},
+      [&](const std::string &absPath, size_t worker) {
+        AFileInfo finf(
+            std::string_view(absPath).substr(projectCacheFolder.size()));
+        std::string_view ext = finf.GetExtension();
+
+        if (ext.empty()) {
+          return;
+        }
 
-  DirectoryScanner sc;
-  sc.Scan(projectCacheFolder);
+        ext.remove_prefix(1);
 
-  for (std::string f : sc.Files()) {
-    f.erase(0, projectCacheFolder.size());
-    AFileInfo finf(f);
-    std::string_view ext = finf.GetExtension();
-    ext.remove_prefix(1);
+        GetClassFromExtension(ext)
+            .Success([&](uint32 value) {
+              cachedFiles[worker].emplace_back(
+                  ResourceHash(JenkinsHash3_(finf.GetFullPathNoExt()), value),
+                  finf.GetFullPath());
+            })
+            .Unused();
+      });
 
-    GetClassFromExtension(ext)
-        .Success([&](uint32 value) {
-          ResourceHash rhash(JenkinsHash3_(finf.GetFullPathNoExt()), value);
+  std::lock_guard lg(RESOURCES_MTX);
 
-          resources.insert(
-              {rhash, {std::string(finf.GetFullPath()), {rhash, {}}}});
-        })
-        .Unused();
+  for (auto &f : cachedFiles) {
+    for (auto &[rhash, localPath] : f) {
+      resources.insert({rhash, {std::move(localPath), {rhash, {}}}});
+    }
   }
 }
 
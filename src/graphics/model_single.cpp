@@ -11,6 +11,12 @@ namespace prime::graphics {
 static void AddModelSingle(ModelSingle &hdr, common::ResourceHash referee) {
   const VertexArray *verts = common::LinkResource<VertexArray>(hdr.vertexArray);
 
+  if (!verts) {
+    printerror("Cannot find vertex array " << std::hex
+                                           << hdr.vertexArray.Hash().name);
+    return;
+  }
+
   RebuildProgram(hdr, referee, 0);
 
   glGenBuffers(1, &hdr.transformBuffer);
@@ -35,6 +41,12 @@ static void AddModelSingle(ModelSingle &hdr, common::ResourceHash referee) {
   for (auto &u : hdr.uniformBlocks) {
     auto uData = reinterpret_cast<char *>(common::LinkResource(u.data));
 
+    if (!uData) {
+      printerror("Cannot find uniform block data " << std::hex
+                                                   << u.data.Hash().name);
+      continue;
+    }
+
     if (u.dataSize == 0) {
       u.dataSize = common::FindResource(uData).buffer.size();
     }
@@ -61,6 +73,11 @@ void Draw(const ModelSingle &model) {
                    model.transformBuffer);
 
   for (auto &u : model.uniformBlocks) {
+    // Block data was missing, buffer was never created
+    if (!u.bufferIndex) {
+      continue;
+    }
+
     glBindBufferBase(GL_UNIFORM_BUFFER, u.bindIndex, u.bufferIndex);
     glBindBuffer(GL_UNIFORM_BUFFER, u.bufferIndex);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, u.dataSize, u.data.operator->());
@@ -281,10 +298,14 @@ template <> class prime::common::InvokeGuard<prime::graphics::ModelSingle> {
                   return;
                 }
 
-                common::LoadResource(hash)
-                    .As<graphics::ModelSingle>()
-                    .Success([hash](graphics::ModelSingle *hdr) {
-                      graphics::RebuildProgram(*hdr, hash, 0);
+                // Model removed meanwhile, nothing to rebuild
+                common::TryLoadResource(hash)
+                    .Success([hash](ResourceData *data) {
+                      data->As<graphics::ModelSingle>()
+                          .Success([hash](graphics::ModelSingle *hdr) {
+                            graphics::RebuildProgram(*hdr, hash, 0);
+                          })
+                          .Unused();
                     })
                     .Unused();
               },
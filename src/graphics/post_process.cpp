@@ -43,18 +43,24 @@ PostProcessStage AddPostProcessStage(JenHash3 object,
   PostProcessStage retVal;
   retVal.program = glCreateProgram();
 
-  {
-    auto &res = common::LoadResource(
-        common::MakeHash<graphics::VertexSource>("basics/viewport"));
-    uint32 vtStage = CompileStage(GL_VERTEX_SHADER, res.buffer.c_str());
-    glAttachShader(retVal.program, vtStage);
-  }
-  {
-    auto &res = common::LoadResource(
-        common::MakeHash<graphics::FragmentSource>(object));
-    uint32 vtStage = CompileStage(GL_FRAGMENT_SHADER, res.buffer.c_str());
-    glAttachShader(retVal.program, vtStage);
-  }
+  // Missing stage is reported, program fails to link
+  auto AttachStage = [&](uint32 type, common::ResourceHash hash) {
+    auto res = common::TryLoadResource(hash);
+
+    if (res.status) {
+      printerror("Cannot find post process shader " << std::hex << hash.name);
+      return;
+    }
+
+    uint32 stage =
+        CompileStage(type, std::string(res.retVal->buffer).c_str());
+    glAttachShader(retVal.program, stage);
+  };
+
+  AttachStage(GL_VERTEX_SHADER,
+              common::MakeHash<graphics::VertexSource>("basics/viewport"));
+  AttachStage(GL_FRAGMENT_SHADER,
+              common::MakeHash<graphics::FragmentSource>(object));
 
   glLinkProgram(retVal.program);
 
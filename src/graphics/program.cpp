@@ -3,7 +3,7 @@
 #include "utils/shader_preprocessor.hpp"
 #include <GL/glew.h>
 #include <algorithm>
-#include <set>
+#include <stdexcept>
 
 namespace {
 using GLShaderObject = uint32;
@@ -13,13 +13,18 @@ struct ShaderObject {
   std::vector<uint32> programs;
 };
 static std::map<uint32, GLShaderObject> shaderObjects;
-static std::map<JenHash3, std::set<prime::common::ResourceHash>>
-    STAGE_REFERENCES;
 
 static bool CompileShader(prime::graphics::StageObject &s,
                           std::span<std::string_view> defBuffer) {
-  std::string shaderSource =
+  auto preprocessed =
       prime::utils::PreprocessShader(s.resource, s.type, defBuffer);
+
+  if (preprocessed.status) {
+    printerror("Cannot find shader source " << std::hex << uint32(s.resource));
+    throw std::runtime_error("Missing shader source");
+  }
+
+  std::string shaderSource = std::move(preprocessed.retVal);
   uint32 sourceHash = JenkinsHash_(shaderSource);
 
   if (auto found = shaderObjects.find(sourceHash);
@@ -156,7 +161,8 @@ CreateProgram(Program &prog, common::ResourceHash referee,
   bool fullyCached = true;
 
   for (auto &s : pgm.stages) {
-    STAGE_REFERENCES[s.resource].emplace(referee);
+    common::AddReloadDependency(
+        common::MakeHash<StageObject>(uint32(s.resource)), referee);
     bool cached = CompileShader(s, {defs.data(), defs.size()});
 
     if (!cached) {
@@ -224,33 +230,3 @@ REGISTER_CLASS(prime::graphics::UniformBlockData);
 REGISTER_CLASS(prime::graphics::VertexSource);
 REGISTER_CLASS(prime::graphics::FragmentSource);
 REGISTER_CLASS(prime::graphics::GeometrySource);
-
-template <> class prime::common::InvokeGuard<prime::graphics::StageObject> {
-  static inline const bool data =
-      prime::common::AddResourceHandle<graphics::StageObject>({
-          .Process = nullptr,
-          .Delete = nullptr,
-          .Update =
-              [](ResourceHash hash) {
-                if (hash.type !=
-                    common::GetClassHash<graphics::StageObject>()) {
-                  return;
-                }
-
-                auto found = STAGE_REFERENCES.find(hash.name);
-
-                if (found == STAGE_REFERENCES.end()) {
-                  return;
-                }
-
-                auto &stages = found->second;
-
-                for (auto &stage : stages) {
-                  GetClassHandle(stage.type)
-                      .Success([&](const ResourceHandle *item) {
-                        item->Update(stage);
-                      }).Unused();
-                }
-              },
-      });
-};
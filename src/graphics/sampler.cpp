@@ -1,5 +1,6 @@
 #include "graphics/sampler.hpp"
 #include "common/resource.hpp"
+#include "spike/master_printer.hpp"
 #include "spike/type/vectors.hpp"
 #include <GL/glew.h>
 #include <map>
@@ -48,8 +49,14 @@ uint32 LookupSampler(uint32 hash) {
     return found->second;
   }
 
-  common::LoadResource(
-      common::ResourceHash(hash, common::GetClassHash<graphics::Sampler>()));
+  // Sampler object 0 leaves texture parameters in effect
+  const common::ResourceHash resHash(
+      hash, common::GetClassHash<graphics::Sampler>());
+
+  if (common::TryLoadResource(resHash).status) {
+    printerror("Cannot find sampler " << std::hex << hash);
+    return 0;
+  }
 
   return samplerUnits.at(hash);
 }
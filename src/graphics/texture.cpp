@@ -1,4 +1,5 @@
 #include "graphics/detail/texture.hpp"
+#include "spike/master_printer.hpp"
 #include "utils/texture.hpp"
 #include <GL/glew.h>
 #include <deque>
@@ -37,7 +38,16 @@ static void LoadBindedTextureLevels(DeferredPayload pl) {
   auto &hdr = pl.hdr;
   auto resource = prime::utils::RedirectTexture(
       prime::common::ResourceHash(pl.hash), pl.streamIndex);
-  auto &data = prime::common::LoadResource(resource);
+  auto loaded = prime::common::TryLoadResource(resource);
+
+  // Stream removed after header was loaded, texture keeps levels it has
+  if (loaded.status) {
+    printerror("Cannot find texture stream " << int(pl.streamIndex) << " of "
+                                             << std::hex << pl.hash);
+    return;
+  }
+
+  auto &data = *loaded.retVal;
   uint8 minLevel = 255;
 
   glBindTexture(hdr.target, pl.object);
@@ -245,10 +255,10 @@ TextureUnit prime::graphics::LookupTexture(uint32 hash) {
     return TEXTURE_UNITS.at(TEXTURE_REMAPS.at(hash));
   }
 
-  try {
-    common::LoadResource(
-        common::ResourceHash(hash, common::GetClassHash<graphics::Texture>()));
-  } catch (const es::FileNotFoundError &) {
+  const common::ResourceHash resHash(hash,
+                                     common::GetClassHash<graphics::Texture>());
+
+  if (common::TryLoadResource(resHash).status) {
     MakeErrorTexture();
     return ERROR_TEXTURE;
   }
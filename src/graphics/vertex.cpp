@@ -1,4 +1,5 @@
 #include "graphics/detail/vertex_array.hpp"
+#include "spike/master_printer.hpp"
 #include "spike/util/supercore.hpp"
 #include <GL/glew.h>
 #include <map>
@@ -28,9 +29,16 @@ void AddVertexArray(prime::graphics::VertexArray &vtArray) {
       glGenBuffers(1, &bId);
       glBindBuffer(b.target, bId);
       buffers.emplace(b.buffer, BufferBind{bId, 1});
-      auto &resData = prime::common::LoadResource(b.buffer);
-      glBufferData(b.target, b.size, resData.buffer.data(), b.usage);
-      prime::common::FreeResource(resData);
+      auto resData = prime::common::TryLoadResource(b.buffer);
+
+      // Storage is still allocated, so draw does not read past buffer
+      if (resData.status) {
+        printerror("Cannot find vertex buffer " << std::hex << b.buffer.name);
+        glBufferData(b.target, b.size, nullptr, b.usage);
+      } else {
+        glBufferData(b.target, b.size, resData.retVal->buffer.data(), b.usage);
+        prime::common::FreeResource(*resData.retVal);
+      }
     }
 
     for (auto &a : b.attributes) {
@@ -686,28 +686,28 @@ static SQInteger AddResource(HSQUIRRELVM v) {
           oPath.append(cls->extension);
 
           return prime::common::RegisterResource(oPath).Success([&] {
-            std::ofstream ostr(cacheFolder + oPath,
-                               std::ios::binary | std::ios::out);
+            const std::string outPath = cacheFolder + oPath;
+            const std::string tmpPath = pu::TempCachePath(outPath);
+            std::ofstream ostr(tmpPath, std::ios::binary | std::ios::out);
 
             if (ostr.fail()) {
-              oPath = cacheFolder;
+              std::string folder = cacheFolder;
 
               AFileInfo finf(path);
               auto exploded = finf.Explode();
               exploded.pop_back();
 
               for (auto &e : exploded) {
-                oPath.append(e);
-                oPath.push_back('/');
-                es::mkdir(oPath);
+                folder.append(e);
+                folder.push_back('/');
+                es::mkdir(folder);
               }
 
-              oPath.append(finf.GetFilename());
-              oPath.push_back('.');
-              oPath.append(cls->extension);
-              ostr.open(oPath, std::ios::binary | std::ios::out);
+              ostr.open(tmpPath, std::ios::binary | std::ios::out);
             }
             ostr.write(built.data(), built.size());
+            ostr.close();
+            pu::CommitCachePath(outPath);
           });
         });
         sq_poptop(v);
@@ -816,8 +816,13 @@ static SQInteger dofile(HSQUIRRELVM v) {
     return 0;
   };
 
-  std::ofstream wr(oPath, std::ios::binary | std::ios::out);
-  sq_writeclosure(v, wrf, &wr, inputCrc);
+  {
+    std::ofstream wr(prime::utils::TempCachePath(oPath),
+                     std::ios::binary | std::ios::out);
+    sq_writeclosure(v, wrf, &wr, inputCrc);
+  }
+
+  prime::utils::CommitCachePath(oPath);
 
   sq_pushroottable(v);
   if (SQ_FAILED(sq_call(v, 1, SQFalse, SQTrue))) {
@@ -0,0 +1,341 @@
+#include "utils/batch_read.hpp"
+#include "utils/thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace prime::utils {
+namespace {
+// Single read operation is limited by kernel to this many bytes
+constexpr size_t MAX_READ = 0x7ffff000;
+// Files opened at once, same as ring depth
+constexpr size_t MAX_WINDOW = 256;
+
+struct ReadJob {
+  ReadRequest *request;
+  int fd;
+  size_t size;
+  size_t done = 0;
+};
+
+// Minimal io_uring setup over raw syscalls, queue is used only for reads
+struct Uring {
+  int fd = -1;
+  void *sqRing = MAP_FAILED;
+  void *cqRing = MAP_FAILED;
+  io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+  size_t sqRingSize = 0;
+  size_t cqRingSize = 0;
+  size_t sqesSize = 0;
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+  io_uring_cqe *cqes;
+  unsigned numEntries = 0;
+
+  Uring() = default;
+  Uring(const Uring &) = delete;
+
+  ~Uring() {
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, sqesSize);
+    }
+
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+      munmap(cqRing, cqRingSize);
+    }
+
+    if (sqRing != MAP_FAILED) {
+      munmap(sqRing, sqRingSize);
+    }
+
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  bool Init(unsigned depth) {
+    io_uring_params params{};
+    fd = syscall(__NR_io_uring_setup, depth, &params);
+
+    if (fd < 0) {
+      return false;
+    }
+
+    numEntries = params.sq_entries;
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    if (sqRing == MAP_FAILED) {
+      return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      cqRing = sqRing;
+    } else {
+      cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+      if (cqRing == MAP_FAILED) {
+        return false;
+      }
+    }
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(
+        mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+
+    char *sq = static_cast<char *>(sqRing);
+    char *cq = static_cast<char *>(cqRing);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    return true;
+  }
+
+  void PushRead(ReadJob &job, uint64_t userData) {
+    const unsigned tail = *sqTail;
+    const unsigned index = tail & *sqMask;
+    io_uring_sqe &sqe = sqes[index];
+    sqe = {};
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = job.fd;
+    sqe.off = job.done;
+    sqe.addr = reinterpret_cast<uint64_t>(job.request->buffer->data() +
+                                          job.done);
+    sqe.len = std::min(job.size - job.done, MAX_READ);
+    sqe.user_data = userData;
+    sqArray[index] = index;
+    std::atomic_ref(*sqTail).store(tail + 1, std::memory_order_release);
+  }
+
+  int Enter(unsigned toSubmit, unsigned minComplete) {
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                   IORING_ENTER_GETEVENTS, nullptr, 0);
+  }
+
+  template <class F> void Reap(F &&cb) {
+    unsigned head = *cqHead;
+    const unsigned tail =
+        std::atomic_ref(*cqTail).load(std::memory_order_acquire);
+
+    for (; head != tail; head++) {
+      const io_uring_cqe &cqe = cqes[head & *cqMask];
+      cb(cqe.user_data, cqe.res);
+    }
+
+    std::atomic_ref(*cqHead).store(head, std::memory_order_release);
+  }
+};
+
+void ReadSync(ReadJob &job) {
+  while (job.done < job.size) {
+    const ssize_t result =
+        pread(job.fd, job.request->buffer->data() + job.done,
+              std::min(job.size - job.done, MAX_READ), job.done);
+
+    if (result < 0 && errno == EINTR) {
+      continue;
+    } else if (result < 0) {
+      job.request->error = errno;
+      return;
+    } else if (result == 0) {
+      // File shrank since fstat
+      job.request->buffer->resize(job.done);
+      return;
+    }
+
+    job.done += result;
+  }
+}
+
+// Unfinished jobs are left for pread
+void ReadUring(std::vector<ReadJob> &jobs) {
+  static thread_local Uring ring;
+  static thread_local bool ringValid = ring.Init(256);
+
+  if (!ringValid) {
+    return;
+  }
+
+  std::vector<size_t> queued;
+  queued.reserve(jobs.size());
+
+  for (size_t i = jobs.size(); i > 0; i--) {
+    queued.push_back(i - 1);
+  }
+
+  unsigned inFlight = 0;
+  unsigned toSubmit = 0;
+
+  while (!queued.empty() || inFlight > 0) {
+    while (!queued.empty() && inFlight < ring.numEntries) {
+      ring.PushRead(jobs[queued.back()], queued.back());
+      queued.pop_back();
+      toSubmit++;
+      inFlight++;
+    }
+
+    if (const int submitted = ring.Enter(toSubmit, 1); submitted >= 0) {
+      toSubmit -= submitted;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      if (inFlight == toSubmit) {
+        // Nothing reached kernel, safe to leave everything for pread
+        ringValid = false;
+        return;
+      }
+
+      continue;
+    }
+
+    ring.Reap([&](uint64_t index, int result) {
+      ReadJob &job = jobs[index];
+      inFlight--;
+
+      if (result == -EINTR || result == -EAGAIN) {
+        queued.push_back(index);
+      } else if (result == -EINVAL || result == -EOPNOTSUPP) {
+        // IORING_OP_READ is not supported by kernel
+        ringValid = false;
+      } else if (result < 0) {
+        job.request->error = -result;
+        job.done = job.size;
+      } else if (result == 0) {
+        job.request->buffer->resize(job.done);
+        job.done = job.size;
+      } else {
+        job.done += result;
+
+        if (job.done < job.size) {
+          queued.push_back(index);
+        }
+      }
+    });
+  }
+}
+
+void ReadPool(std::vector<ReadJob> &jobs) {
+  std::vector<std::future<void>> tasks;
+
+  for (auto &j : jobs) {
+    if (j.done < j.size) {
+      tasks.emplace_back(WorkerPool().Enqueue([&job = j] { ReadSync(job); }));
+    }
+  }
+
+  for (auto &t : tasks) {
+    t.wait();
+  }
+}
+
+// Open files count against RLIMIT_NOFILE, most of it is left to the rest of
+// process
+size_t WindowSize() {
+  rlimit limit;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) || limit.rlim_cur == RLIM_INFINITY) {
+    return MAX_WINDOW;
+  }
+
+  return std::clamp<size_t>(limit.rlim_cur / 4, 1, MAX_WINDOW);
+}
+
+void ReadWindow(std::span<ReadRequest> requests) {
+  std::vector<ReadJob> jobs;
+  jobs.reserve(requests.size());
+
+  for (auto &r : requests) {
+    int fd = -1;
+    size_t pathIndex = 0;
+    r.error = ENOENT;
+
+    for (; pathIndex < r.paths.size(); pathIndex++) {
+      fd = open(r.paths[pathIndex].c_str(), O_RDONLY | O_CLOEXEC);
+
+      if (fd >= 0) {
+        r.error = 0;
+        break;
+      } else if (errno != ENOENT && errno != ENOTDIR) {
+        r.error = errno;
+      }
+    }
+
+    if (fd < 0) {
+      continue;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+      r.error = errno;
+      close(fd);
+      continue;
+    }
+
+    if (pathIndex < r.numMappable && size_t(st.st_size) >= MAP_THRESHOLD) {
+      r.error = r.buffer->Map(fd, st.st_size);
+
+      if (r.error == 0) {
+        close(fd);
+        continue;
+      }
+
+      // Not mappable (pipe, special filesystem), read it instead
+      r.error = 0;
+    }
+
+    r.buffer->resize(st.st_size);
+    jobs.push_back({.request = &r, .fd = fd, .size = size_t(st.st_size)});
+  }
+
+  if (jobs.size() == 1) {
+    // Single file is not worth any queue
+    ReadSync(jobs.front());
+  } else if (jobs.size() > 1) {
+    ReadUring(jobs);
+    ReadPool(jobs);
+  }
+
+  for (auto &j : jobs) {
+    close(j.fd);
+  }
+}
+} // namespace
+
+void BatchRead(std::span<ReadRequest> requests) {
+  const size_t windowSize = WindowSize();
+
+  // Opened, read and closed window by window
+  for (size_t i = 0; i < requests.size(); i += windowSize) {
+    ReadWindow(requests.subspan(i, std::min(windowSize, requests.size() - i)));
+  }
+}
+} // namespace prime::utils
@@ -0,0 +1,142 @@
+#include "utils/converters/block_compress.hpp"
+#include "ispc_texcomp.h"
+#include "utils/thread_pool.hpp"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace prime::utils {
+namespace {
+// Smaller bands cost more in scheduling than they save
+constexpr uint32 MIN_BAND_BLOCKS = 256;
+// Bands per thread, BC7 blocks differ in cost a lot, more bands keep all
+// threads busy until the end
+constexpr uint32 BANDS_PER_THREAD = 4;
+
+void CompressSurface(const rgba_surface &surface, BlockFormat format,
+                     const bc7_enc_settings &bc7Settings, uint8_t *outData) {
+  // Surface is not modified by any of these
+  rgba_surface *surf = const_cast<rgba_surface *>(&surface);
+
+  switch (format) {
+  case BlockFormat::BC1:
+    CompressBlocksBC1(surf, outData);
+    break;
+  case BlockFormat::BC3:
+    CompressBlocksBC3(surf, outData);
+    break;
+  case BlockFormat::BC4:
+    CompressBlocksBC4(surf, outData);
+    break;
+  case BlockFormat::BC5:
+    CompressBlocksBC5(surf, outData);
+    break;
+  case BlockFormat::BC5S:
+    CompressBlocksBC5S(surf, outData);
+    break;
+  case BlockFormat::BC7:
+    CompressBlocksBC7(surf, outData,
+                      const_cast<bc7_enc_settings *>(&bc7Settings));
+    break;
+  }
+}
+
+// Shared with worker tasks, which can start after CompressBlocks returned
+struct BandJob {
+  rgba_surface surface;
+  BlockFormat format;
+  bc7_enc_settings bc7Settings;
+  uint8_t *outData;
+  uint32 blockRowsPerBand;
+  uint32 numBands;
+  std::atomic<uint32> nextBand{0};
+  std::atomic<uint32> numDone{0};
+
+  void Run() {
+    const uint32 numBlockRows = surface.height / 4;
+    const size_t blockRowSize =
+        size_t(surface.width / 4) * BlockSize(format);
+
+    for (uint32 b = nextBand++; b < numBands; b = nextBand++) {
+      const uint32 firstRow = b * blockRowsPerBand;
+      rgba_surface band = surface;
+      band.ptr += size_t(firstRow) * 4 * surface.stride;
+      band.height =
+          std::min(blockRowsPerBand, numBlockRows - firstRow) * 4;
+      CompressSurface(band, format, bc7Settings,
+                      outData + firstRow * blockRowSize);
+
+      if (++numDone == numBands) {
+        numDone.notify_all();
+      }
+    }
+  }
+};
+} // namespace
+
+uint32 BlockSize(BlockFormat format) {
+  switch (format) {
+  case BlockFormat::BC1:
+  case BlockFormat::BC4:
+    return 8;
+  default:
+    return 16;
+  }
+}
+
+std::string CompressBlocks(const rgba_surface &surface, BlockFormat format,
+                           const bc7_enc_settings *bc7Settings,
+                           uint32 numThreads) {
+  if (format == BlockFormat::BC7 && !bc7Settings) {
+    throw std::invalid_argument("BC7 requires bc7Settings");
+  }
+
+  const uint32 numBlockRows = surface.height / 4;
+  const uint32 blocksPerRow = surface.width / 4;
+  std::string retVal;
+  retVal.resize(size_t(numBlockRows) * blocksPerRow * BlockSize(format));
+
+  if (retVal.empty()) {
+    return retVal;
+  }
+
+  ThreadPool &pool = WorkerPool();
+  // Calling thread is one of them
+  const uint32 maxThreads = pool.NumThreads() + 1;
+  numThreads = numThreads ? std::min(numThreads, maxThreads) : maxThreads;
+
+  auto job = std::make_shared<BandJob>();
+  job->surface = surface;
+  job->format = format;
+
+  if (bc7Settings) {
+    job->bc7Settings = *bc7Settings;
+  }
+
+  job->outData = reinterpret_cast<uint8_t *>(retVal.data());
+  const uint32 minBandRows =
+      (MIN_BAND_BLOCKS + blocksPerRow - 1) / blocksPerRow;
+  const uint32 targetBands = numThreads * BANDS_PER_THREAD;
+  job->blockRowsPerBand = std::max(
+      minBandRows, (numBlockRows + targetBands - 1) / targetBands);
+  job->numBands =
+      (numBlockRows + job->blockRowsPerBand - 1) / job->blockRowsPerBand;
+
+  const uint32 numHelpers = std::min(numThreads, job->numBands) - 1;
+
+  for (uint32 i = 0; i < numHelpers; i++) {
+    pool.Enqueue([job] { job->Run(); });
+  }
+
+  job->Run();
+
+  // Helpers that did not start yet will find no band left, so they are
+  // not waited for
+  for (uint32 done = job->numDone; done < job->numBands;
+       done = job->numDone) {
+    job->numDone.wait(done);
+  }
+
+  return retVal;
+}
+} // namespace prime::utils
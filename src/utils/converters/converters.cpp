@@ -7,7 +7,10 @@
 #include "spike/io/binwritter.hpp"
 #include "spike/io/directory_scanner.hpp"
 #include "spike/io/stat.hpp"
+#include "spike/master_printer.hpp"
 #include "spike/reflect/reflector.hpp"
+#include <cstdio>
+#include <cstring>
 #include <map>
 #include <memory>
 
@@ -133,19 +136,31 @@ struct Context : AppContext {
   }
 
   NewFileContext NewFile(const std::string &path) override {
+    CommitOutFile();
     const std::string &cacheDir = prime::common::CacheDataFolder();
     const std::string filePath = cacheDir + path;
+    const std::string tmpPath = prime::utils::TempCachePath(filePath);
     ::prime::common::RegisterResource(path);
     try {
-      outFile = BinWritter(filePath);
+      outFile = BinWritter(tmpPath);
     } catch (const es::FileInvalidAccessError &e) {
       // todo: add to watchlist
       mkdirs(filePath);
-      outFile = BinWritter(filePath);
+      outFile = BinWritter(tmpPath);
     }
+    outFilePath = filePath;
     return {outFile.BaseStream(), filePath, cacheDir.size()};
   }
 
+  // Previous output is complete once next one is requested
+  void CommitOutFile() {
+    if (!outFilePath.empty()) {
+      es::Dispose(outFile);
+      prime::utils::CommitCachePath(outFilePath);
+      outFilePath.clear();
+    }
+  }
+
   NewTexelContext *NewImage(NewTexelContextCreate,
                             const std::string *) override {
     throw std::logic_error("Unsupported call");
@@ -156,9 +171,12 @@ struct Context : AppContext {
     workingFile.Load(input.localPath);
   }
 
+  ~Context() { CommitOutFile(); }
+
   ::prime::common::ResourcePath path;
 
   BinWritter outFile;
+  std::string outFilePath;
 
   BinReader mainFile;
   BinReader streamedFiles[32];
@@ -220,6 +238,17 @@ void ContextOutputPath(std::string output) {
   basePathParts = basePath.Explode();
 }
 
+std::string TempCachePath(const std::string &path) { return path + ".tmp"; }
+
+void CommitCachePath(const std::string &path) {
+  const std::string tmpPath = TempCachePath(path);
+
+  if (std::rename(tmpPath.c_str(), path.c_str())) {
+    PrintError("Cannot replace ", path, " ", strerror(errno));
+    std::remove(tmpPath.c_str());
+  }
+}
+
 std::unique_ptr<AppContext> MakeContext(const common::ResourcePath &filePath) {
   return std::make_unique<Context>(filePath);
 }
@@ -15,6 +15,7 @@
 #include <GL/glext.h>
 
 #include "graphics/detail/texture.hpp"
+#include "utils/converters/block_compress.hpp"
 #include "utils/debug.hpp"
 #include "utils/texture.hpp"
 
@@ -53,6 +54,7 @@ struct GLTEX : ReflectorBase<GLTEX> {
   std::string normalMapPatterns = "_normal$";
   std::string normalMapPatternsOld;
   int32 streamLimit[NUM_STREAMS]{128, 2048, 4096, -1};
+  uint32 threads = 0;
   PathFilter normalExts;
 };
 
@@ -75,7 +77,10 @@ REFLECT(
                         "maps separated by comma."}),
     MEMBERNAME(streamLimit, "stream-limit",
                ReflDesc{
-                   "Exclusive pixel limit per stream. Must be power of 2."}), )
+                   "Exclusive pixel limit per stream. Must be power of 2."}),
+    MEMBERNAME(threads, "threads",
+               ReflDesc{"Number of threads compressing single texture. 0 "
+                        "uses all workers."}), )
 namespace {
 GLTEX &Settings() {
   static GLTEX settings{};
@@ -518,20 +523,17 @@ void ProcessImage(AppContext *ctx) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
         entry.bufferSize = rawData.bcSize * 16;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
-        CompressBlocksBC3(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC3, nullptr, settings.threads);
         wr.WriteContainer(buffer);
       } else if (settings.rgbaType == RGBAType::BC7) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
         entry.bufferSize = rawData.bcSize * 16;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
         bc7_enc_settings prof;
         GetProfile_alpha_basic(&prof);
-        CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                          &prof);
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC7, &prof, settings.threads);
         wr.WriteContainer(buffer);
       }
     } else if (rawData.origChannels == STBI_rgb) {
@@ -545,20 +547,17 @@ void ProcessImage(AppContext *ctx) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
         entry.bufferSize = rawData.bcSize * 8;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
-        CompressBlocksBC1(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC1, nullptr, settings.threads);
         wr.WriteContainer(buffer);
       } else if (settings.rgbType == RGBType::BC7) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
         entry.bufferSize = rawData.bcSize * 16;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
         bc7_enc_settings prof;
         GetProfile_basic(&prof);
-        CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                          &prof);
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC7, &prof, settings.threads);
         wr.WriteContainer(buffer);
       }
     } else if (rawData.origChannels == STBI_grey_alpha) {
@@ -572,20 +571,17 @@ void ProcessImage(AppContext *ctx) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RG_RGTC2;
         entry.bufferSize = rawData.bcSize * 16;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
-        CompressBlocksBC5(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC5, nullptr, settings.threads);
         wr.WriteContainer(buffer);
       } else if (settings.rgType == RGType::BC7) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
         entry.bufferSize = rawData.bcSize * 16;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
         bc7_enc_settings prof;
         GetProfile_basic(&prof);
-        CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                          &prof);
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC7, &prof, settings.threads);
         wr.WriteContainer(buffer);
       }
     } else if (rawData.origChannels == STBI_grey) {
@@ -599,20 +595,18 @@ void ProcessImage(AppContext *ctx) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RED_RGTC1;
         entry.bufferSize = rawData.bcSize * 8;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
-        CompressBlocksBC5(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+        surf.stride = rawData.width;
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC4, nullptr, settings.threads);
         wr.WriteContainer(buffer);
       } else if (settings.monochromeType == MonochromeType::BC7) {
         metaFlags += TextureFlag::Compressed;
         meta.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
         entry.bufferSize = rawData.bcSize * 16;
-        std::string buffer;
-        buffer.resize(entry.bufferSize);
         bc7_enc_settings prof;
         GetProfile_basic(&prof);
-        CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                          &prof);
+        std::string buffer =
+            CompressBlocks(surf, BlockFormat::BC7, &prof, settings.threads);
         wr.WriteContainer(buffer);
       }
     }
@@ -641,9 +635,6 @@ void ProcessImage(AppContext *ctx) {
       txSwizzle.emplace(SwizzleHolder{{GL_RED, GL_ALPHA, GL_ONE, GL_ONE}});
       meta.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
       entry.bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(entry.bufferSize);
-
       // Reswizzle
       const size_t stride = 4;
       const size_t numLoops = rawData.rawSize / stride;
@@ -673,7 +664,8 @@ void ProcessImage(AppContext *ctx) {
         memcpy(rData + index, &value, restBytes);
       }
 
-      CompressBlocksBC3(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer =
+          CompressBlocks(surf, BlockFormat::BC3, nullptr, settings.threads);
       free(rData);
       wr.WriteContainer(buffer);
     } else if (settings.normalType == NormalType::BC7) {
@@ -682,29 +674,25 @@ void ProcessImage(AppContext *ctx) {
 
       meta.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
       entry.bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(entry.bufferSize);
       bc7_enc_settings prof;
       GetProfile_basic(&prof);
-      CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                        &prof);
+      std::string buffer =
+          CompressBlocks(surf, BlockFormat::BC7, &prof, settings.threads);
       wr.WriteContainer(buffer);
     } else if (settings.normalType == NormalType::BC5) {
       metaFlags += TextureFlag::Compressed;
       meta.internalFormat = GL_COMPRESSED_RG_RGTC2;
       entry.bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(entry.bufferSize);
-      CompressBlocksBC5(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer =
+          CompressBlocks(surf, BlockFormat::BC5, nullptr, settings.threads);
       wr.WriteContainer(buffer);
     } else if (settings.normalType == NormalType::BC5S) {
       metaFlags += TextureFlag::Compressed;
       meta.internalFormat = GL_COMPRESSED_SIGNED_RG_RGTC2;
       metaFlags += TextureFlag::SignedNormal;
       entry.bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(entry.bufferSize);
-      CompressBlocksBC5S(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer =
+          CompressBlocks(surf, BlockFormat::BC5S, nullptr, settings.threads);
       wr.WriteContainer(buffer);
     } else {
       meta.format = GL_RG;
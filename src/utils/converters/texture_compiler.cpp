@@ -1,6 +1,7 @@
 #include "utils/converters/texture_compiler.hpp"
 #include "graphics/detail/texture.hpp"
 #include "utils/converters.hpp"
+#include "utils/converters/block_compress.hpp"
 #include "utils/debug.hpp"
 #include "utils/texture.hpp"
 
@@ -53,16 +54,18 @@ struct RawImageData {
 
 uint32 GetCrc(std::istream &str);
 
+// Written under temporary name until CommitFile
 BinWritter NewFile(const std::string &path) {
   std::string absPath = prime::common::CacheDataFolder() + path;
+  const std::string tmpPath = prime::utils::TempCachePath(absPath);
   BinWritter ostr;
 
   try {
-    ostr.Open(absPath);
+    ostr.Open(tmpPath);
   } catch (const es::FileInvalidAccessError &) {
     AFileInfo finf(absPath);
     mkdirs(std::string(finf.GetFolder()));
-    ostr.Open(absPath);
+    ostr.Open(tmpPath);
   }
 
   prime::common::RegisterResource(path).Unused();
@@ -70,6 +73,10 @@ BinWritter NewFile(const std::string &path) {
   return ostr;
 }
 
+void CommitFile(const std::string &path) {
+  prime::utils::CommitCachePath(prime::common::CacheDataFolder() + path);
+}
+
 namespace prime::utils {
 
 RawImageData GetImageData(BinReaderRef rd, TextureCompiler &compiler) {
@@ -303,26 +310,19 @@ uint32 ConvertGenericSlice(BinWritterRef wr, TextureCompiler &compiler,
       return rawData.rawSize;
     } else if (compiler.rgbaType == TextureCompilerRGBAType::BC1) {
       uint32 bufferSize = rawData.bcSize * 8;
-      std::string buffer;
-      buffer.resize(bufferSize);
-      CompressBlocksBC1(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC1);
       wr.WriteContainer(buffer);
       return bufferSize;
     } else if (compiler.rgbaType == TextureCompilerRGBAType::BC3) {
       uint32 bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(bufferSize);
-      CompressBlocksBC3(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC3);
       wr.WriteContainer(buffer);
       return bufferSize;
     } else if (compiler.rgbaType == TextureCompilerRGBAType::BC7) {
       uint32 bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(bufferSize);
       bc7_enc_settings prof;
       GetProfile_alpha_basic(&prof);
-      CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                        &prof);
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC7, &prof);
       wr.WriteContainer(buffer);
       return bufferSize;
     }
@@ -332,19 +332,14 @@ uint32 ConvertGenericSlice(BinWritterRef wr, TextureCompiler &compiler,
       return rawData.rawSize;
     } else if (compiler.rgbType == TextureCompilerRGBType::BC1) {
       uint32 bufferSize = rawData.bcSize * 8;
-      std::string buffer;
-      buffer.resize(bufferSize);
-      CompressBlocksBC1(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC1);
       wr.WriteContainer(buffer);
       return bufferSize;
     } else if (compiler.rgbType == TextureCompilerRGBType::BC7) {
       uint32 bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(bufferSize);
       bc7_enc_settings prof;
       GetProfile_basic(&prof);
-      CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                        &prof);
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC7, &prof);
       wr.WriteContainer(buffer);
       return bufferSize;
     }
@@ -354,19 +349,14 @@ uint32 ConvertGenericSlice(BinWritterRef wr, TextureCompiler &compiler,
       return rawData.rawSize;
     } else if (compiler.rgType == TextureCompilerRGType::BC5) {
       uint32 bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(bufferSize);
-      CompressBlocksBC5(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC5);
       wr.WriteContainer(buffer);
       return bufferSize;
     } else if (compiler.rgType == TextureCompilerRGType::BC7) {
       uint32 bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(bufferSize);
       bc7_enc_settings prof;
       GetProfile_basic(&prof);
-      CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                        &prof);
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC7, &prof);
       wr.WriteContainer(buffer);
       return bufferSize;
     }
@@ -377,19 +367,14 @@ uint32 ConvertGenericSlice(BinWritterRef wr, TextureCompiler &compiler,
     } else if (compiler.monochromeType == TextureCompilerMonochromeType::BC4) {
       surf.stride = rawData.width;
       uint32 bufferSize = rawData.bcSize * 8;
-      std::string buffer;
-      buffer.resize(bufferSize);
-      CompressBlocksBC4(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC4);
       wr.WriteContainer(buffer);
       return bufferSize;
     } else if (compiler.monochromeType == TextureCompilerMonochromeType::BC7) {
       uint32 bufferSize = rawData.bcSize * 16;
-      std::string buffer;
-      buffer.resize(bufferSize);
       bc7_enc_settings prof;
       GetProfile_basic(&prof);
-      CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()),
-                        &prof);
+      std::string buffer = CompressBlocks(surf, BlockFormat::BC7, &prof);
       wr.WriteContainer(buffer);
       return bufferSize;
     }
@@ -447,9 +432,6 @@ uint32 ConvertNormalSlice(BinWritterRef wr, TextureCompiler &compiler,
 
   if (compiler.normalType == TextureCompilerNormalType::BC3) {
     uint32 bufferSize = rawData.bcSize * 16;
-    std::string buffer;
-    buffer.resize(bufferSize);
-
     // Reswizzle
     const size_t stride = 4;
     const size_t numLoops = rawData.rawSize / stride;
@@ -479,31 +461,25 @@ uint32 ConvertNormalSlice(BinWritterRef wr, TextureCompiler &compiler,
       memcpy(rData + index, &value, restBytes);
     }
 
-    CompressBlocksBC3(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+    std::string buffer = CompressBlocks(surf, BlockFormat::BC3);
     free(rData);
     wr.WriteContainer(buffer);
     return bufferSize;
   } else if (compiler.normalType == TextureCompilerNormalType::BC7) {
     uint32 bufferSize = rawData.bcSize * 16;
-    std::string buffer;
-    buffer.resize(bufferSize);
     bc7_enc_settings prof;
     GetProfile_basic(&prof);
-    CompressBlocksBC7(&surf, reinterpret_cast<uint8_t *>(buffer.data()), &prof);
+    std::string buffer = CompressBlocks(surf, BlockFormat::BC7, &prof);
     wr.WriteContainer(buffer);
     return bufferSize;
   } else if (compiler.normalType == TextureCompilerNormalType::BC5) {
     uint32 bufferSize = rawData.bcSize * 16;
-    std::string buffer;
-    buffer.resize(bufferSize);
-    CompressBlocksBC5(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+    std::string buffer = CompressBlocks(surf, BlockFormat::BC5);
     wr.WriteContainer(buffer);
     return bufferSize;
   } else if (compiler.normalType == TextureCompilerNormalType::BC5S) {
     uint32 bufferSize = rawData.bcSize * 16;
-    std::string buffer;
-    buffer.resize(bufferSize);
-    CompressBlocksBC5S(&surf, reinterpret_cast<uint8_t *>(buffer.data()));
+    std::string buffer = CompressBlocks(surf, BlockFormat::BC5S);
     wr.WriteContainer(buffer);
     return bufferSize;
   } else {
@@ -796,6 +772,14 @@ common::Return<void> Compile(std::string buffer, std::string_view output) {
               return i1.streamIndex < i2.streamIndex;
             });
 
+  for (uint32 i = 0; i <= maxUsedStream; i++) {
+    if (streams[i]) {
+      streams[i].reset();
+      outFile.back() = '0' + i;
+      CommitFile(outFile);
+    }
+  }
+
   metap->numStreams = maxUsedStream + 1;
 
   std::string built =
@@ -803,6 +787,7 @@ common::Return<void> Compile(std::string buffer, std::string_view output) {
   outFile = output;
   outFile.append(common::GetClassExtension<graphics::Texture>());
   NewFile(outFile).WriteContainer(built);
+  CommitFile(outFile);
 
   return {NO_ERROR};
 }
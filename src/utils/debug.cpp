@@ -1,36 +1,67 @@
 #include "utils/debug.hpp"
-#include <algorithm>
 
 namespace prime::utils {
+namespace {
+// Returns index of matching item, key is set to matching or first free key
+template <class Index, class NameAt>
+uint32 *FindIndex(Index &index, std::string_view str, uint64 &key,
+                  NameAt &&nameAt) {
+  for (key = std::hash<std::string_view>{}(str);; key++) {
+    auto found = index.find(key);
+
+    if (found == index.end()) {
+      return nullptr;
+    }
+
+    if (nameAt(found->second) == str) {
+      return &found->second;
+    }
+  }
+}
+} // namespace
+
 ResourceDebugPlayground::ResourceDebugPlayground()
-    : main(AddClass<ResourceDebug>()) {}
+    : main(AddClass<ResourceDebug>()), dependencyIndex(IndexPool()),
+      stringIndex(IndexPool()), classIndex(IndexPool()) {}
+
+void ResourceDebugPlayground::Reset() {
+  PlayGround::Reset();
+  dependencyIndex.clear();
+  stringIndex.clear();
+  classIndex.clear();
+  // First allocation of empty playground, lands at main's offset
+  [[maybe_unused]] Pointer<ResourceDebug> newMain = AddClass<ResourceDebug>();
+  assert(newMain.offset == main.offset);
+}
 
 common::ResourceHash ResourceDebugPlayground::AddRef(std::string_view path_,
                                                      uint32 clHash) {
   auto resHash = common::MakeHash<char>(path_);
   resHash.type = clHash;
 
-  auto found = std::find_if(
-      main->dependencies.begin(), main->dependencies.end(),
-      [&](const ResourceDebugDependency &item) { return path_ == item.path; });
+  uint64 key;
+  const uint32 *found = FindIndex(dependencyIndex, path_, key, [&](uint32 i) {
+    return std::string_view(main->dependencies[i].path);
+  });
 
-  if (found == main->dependencies.end()) {
+  if (!found) {
+    dependencyIndex.emplace(key, main->dependencies.numItems);
     Pointer<ResourceDebugDependency> newDep(ArrayEmplace(main->dependencies));
     NewString(newDep->path, path_);
     ArrayEmplace(newDep->types, clHash);
   } else {
-    ArrayEmplace(found->types, clHash);
+    ArrayEmplace(main->dependencies[*found].types, clHash);
   }
 
   return resHash;
 }
 
 std::string_view ResourceDebugPlayground::AddString(std::string_view str) {
-  auto found =
-      std::find_if(main->strings.begin(), main->strings.end(),
-                   [&](const common::String &item) { return str == item; });
+  uint64 key;
+  auto StringAt = [&](uint32 i) { return std::string_view(main->strings[i]); };
 
-  if (found == main->strings.end()) {
+  if (!FindIndex(stringIndex, str, key, StringAt)) {
+    stringIndex.emplace(key, main->strings.numItems);
     Pointer<common::String> newDep(ArrayEmplace(main->strings));
     NewString(*newDep, str);
   }
@@ -39,6 +70,15 @@ std::string_view ResourceDebugPlayground::AddString(std::string_view str) {
 
 PlayGround::Pointer<ResourceDebugClass>
 ResourceDebugPlayground::AddDebugClass(const reflect::Class *cls) {
+  auto ClassNameAt = [&](uint32 i) {
+    return std::string_view(main->classes[i].className);
+  };
+  uint64 key;
+
+  if (!FindIndex(classIndex, cls->className, key, ClassNameAt)) {
+    classIndex.emplace(key, main->classes.numItems);
+  }
+
   Pointer<ResourceDebugClass> newClass = ArrayEmplace(main->classes);
   NewString(newClass->className, std::string_view(cls->className));
 
@@ -55,16 +95,14 @@ ResourceDebugPlayground::AddDebugClass(const reflect::Class *cls) {
       if (member.types[t].type == reflect::Type::Class) {
         reflect::GetReflectedClass(member.types[t].hash)
             .Success([&](const reflect::Class *subCls) {
-              auto found = std::find_if(
-                  main->classes.begin(), main->classes.end(),
-                  [subCls](const ResourceDebugClass &cls) {
-                    return std::string_view(cls.className) == subCls->className;
-                  });
+              uint64 subKey;
+              const uint32 *found = FindIndex(classIndex, subCls->className,
+                                              subKey, ClassNameAt);
 
-              if (found == main->classes.end()) {
+              if (!found) {
                 Link(newType->definition, AddDebugClass(subCls).operator->());
               } else {
-                Link(newType->definition, found);
+                Link(newType->definition, &main->classes[*found]);
               }
             }).Unused();
       }
@@ -1,9 +1,210 @@
 #include "utils/playground.hpp"
 #include <algorithm>
-
 #include <cassert>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 
 namespace prime::utils {
+namespace {
+struct Relocation {
+  uint32 begin;
+  uint32 end;
+  uint32 alignment;
+  uint32 order;
+  uint32 newBegin = 0;
+  bool isPlaced = false;
+
+  uint32 Size() const { return end - begin; }
+};
+
+// Filler lookup works with sizes modulo this, higher alignments are padded
+constexpr uint32 FILLER_MODULO = 64;
+
+// First block stays in front, rest is placed from highest alignment
+// Padding in front of block is avoided by placing lower aligned block first,
+// one that ends right at required alignment
+// Padding that cannot be avoided is kept as hole for later blocks that fit
+uint32 LayoutBlocks(std::span<Relocation *> sortedBlocks,
+                    std::pmr::memory_resource *scratch) {
+  // {alignment, size % FILLER_MODULO}
+  std::pmr::map<std::pair<uint32, uint32>, std::pmr::vector<Relocation *>>
+      fillers(scratch);
+
+  for (Relocation *r : std::views::reverse(sortedBlocks.subspan(1))) {
+    fillers[{r->alignment, r->Size() % FILLER_MODULO}].push_back(r);
+  }
+
+  auto TakeFiller = [&](uint32 offset, uint32 alignment) -> Relocation * {
+    if (alignment > FILLER_MODULO) {
+      return nullptr;
+    }
+
+    const uint32 padding = GetPadding(offset, alignment);
+
+    for (uint32 a = 1; a < alignment && offset % a == 0; a *= 2) {
+      for (uint32 m = padding; m < FILLER_MODULO; m += alignment) {
+        auto found = fillers.find({a, m});
+
+        if (found == fillers.end()) {
+          continue;
+        }
+
+        std::pmr::vector<Relocation *> &bucket = found->second;
+
+        while (!bucket.empty() && bucket.back()->isPlaced) {
+          bucket.pop_back();
+        }
+
+        if (!bucket.empty()) {
+          Relocation *filler = bucket.back();
+          bucket.pop_back();
+          return filler;
+        }
+      }
+    }
+
+    return nullptr;
+  };
+
+  // {size, begin}
+  std::pmr::set<std::pair<uint32, uint32>> holes(scratch);
+
+  auto PlaceInHole = [&](Relocation &r) {
+    auto hole = holes.lower_bound({r.Size(), 0});
+
+    for (; hole != holes.end(); hole++) {
+      if (GetPadding(hole->second, r.alignment) + r.Size() <= hole->first) {
+        break;
+      }
+    }
+
+    if (hole == holes.end()) {
+      return false;
+    }
+
+    const uint32 holeBegin = hole->second;
+    const uint32 holeEnd = holeBegin + hole->first;
+    holes.erase(hole);
+    r.newBegin = holeBegin + GetPadding(holeBegin, r.alignment);
+
+    if (r.newBegin != holeBegin) {
+      holes.emplace(r.newBegin - holeBegin, holeBegin);
+    }
+
+    if (const uint32 blockEnd = r.newBegin + r.Size(); blockEnd != holeEnd) {
+      holes.emplace(holeEnd - blockEnd, blockEnd);
+    }
+
+    return true;
+  };
+
+  sortedBlocks.front()->isPlaced = true;
+  uint32 dataSize = sortedBlocks.front()->Size();
+
+  for (Relocation *r : sortedBlocks.subspan(1)) {
+    if (r->isPlaced) {
+      continue;
+    }
+
+    r->isPlaced = true;
+
+    if (PlaceInHole(*r)) {
+      continue;
+    }
+
+    if (GetPadding(dataSize, r->alignment)) {
+      if (Relocation *filler = TakeFiller(dataSize, r->alignment)) {
+        filler->isPlaced = true;
+        filler->newBegin = dataSize;
+        dataSize += filler->Size();
+      }
+    }
+
+    const uint32 padding = GetPadding(dataSize, r->alignment);
+
+    if (padding) {
+      holes.emplace(padding, dataSize);
+    }
+
+    r->newBegin = dataSize + padding;
+    dataSize = r->newBegin + r->Size();
+  }
+
+  return dataSize;
+}
+} // namespace
+
+namespace {
+// Set once thread cache is destroyed, late playgrounds free their arena
+thread_local bool ARENA_CACHE_CLOSED = false;
+constexpr size_t MAX_CACHED_ARENAS = 8;
+// Arenas of huge resources are not kept around
+constexpr size_t MAX_CACHED_DATA = 0x1000000;
+} // namespace
+
+struct PlayGround::ArenaCache {
+  std::vector<std::unique_ptr<Arena>> arenas;
+
+  ~ArenaCache() { ARENA_CACHE_CLOSED = true; }
+
+  static ArenaCache &Get() {
+    thread_local ArenaCache cache;
+    return cache;
+  }
+};
+
+PlayGround::Arena *PlayGround::AcquireArena() {
+  if (ARENA_CACHE_CLOSED) {
+    return new Arena;
+  }
+
+  std::vector<std::unique_ptr<Arena>> &arenas = ArenaCache::Get().arenas;
+
+  if (arenas.empty()) {
+    return new Arena;
+  }
+
+  Arena *item = arenas.back().release();
+  arenas.pop_back();
+  return item;
+}
+
+void PlayGround::ArenaDeleter::operator()(Arena *item) const {
+  if (ARENA_CACHE_CLOSED || item->data.capacity() > MAX_CACHED_DATA) {
+    delete item;
+    return;
+  }
+
+  std::vector<std::unique_ptr<Arena>> &arenas = ArenaCache::Get().arenas;
+
+  if (arenas.size() >= MAX_CACHED_ARENAS) {
+    delete item;
+    return;
+  }
+
+  item->data.clear();
+  arenas.emplace_back(item);
+}
+
+PlayGround::PlayGround()
+    : arena(AcquireArena()), data(arena->data), blocks(&arena->pool),
+      gaps(&arena->pool), gapSizes(&arena->pool),
+      localPointers(&arena->pool), pointerTargets(&arena->pool) {
+  Reset();
+}
+
+void PlayGround::Reset() {
+  blocks.clear();
+  numAllocations = 0;
+  localPointers.clear();
+  pointerTargets.clear();
+  gaps.clear();
+  gapSizes.clear();
+  data.assign(0x2000, '\0');
+  gaps.emplace(0, 0x2000);
+  gapSizes.emplace(0x2000, 0);
+}
 
 std::string PlayGround::Build() {
   std::string retval;
@@ -11,268 +212,310 @@ std::string PlayGround::Build() {
     return retval;
   }
 
-  retval.append(blocks.front().View(this));
+  // Relocation table, in order of old offsets
+  std::pmr::vector<Relocation> relocations(&arena->pool);
+  relocations.reserve(blocks.size());
+  uint32 maxAlign = 0;
+
+  for (auto &[begin, b] : blocks) {
+    relocations.emplace_back(Relocation{
+        .begin = b.begin,
+        .end = b.end,
+        .alignment = b.alignment,
+        .order = b.order,
+    });
+    maxAlign = std::max(maxAlign, b.alignment);
+  }
 
-  common::ResourceBase &res =
-      reinterpret_cast<common::ResourceBase &>(retval.front());
-  res.maxAlign = blocks.front().alignment;
+  std::pmr::vector<Relocation *> sortedBlocks(&arena->pool);
+  sortedBlocks.reserve(relocations.size());
 
-  if (blocks.size() == 1) {
-    return retval;
+  for (Relocation &r : relocations) {
+    sortedBlocks.emplace_back(&r);
   }
 
-  std::vector<Block> sortedBlocks(std::next(blocks.begin()), blocks.end());
   std::sort(sortedBlocks.begin(), sortedBlocks.end(),
-            [](const Block &g0, const Block &g1) {
-              return g0.alignment > g1.alignment;
+            [](const Relocation *r0, const Relocation *r1) {
+              return r0->order < r1->order;
             });
+  std::stable_sort(std::next(sortedBlocks.begin()), sortedBlocks.end(),
+                   [](const Relocation *r0, const Relocation *r1) {
+                     return r0->alignment > r1->alignment;
+                   });
 
-  std::vector<Block> newBlocks{blocks.front()};
-  res.maxAlign = std::max(uint32(res.maxAlign), sortedBlocks.front().alignment);
-
-  for (auto &g : sortedBlocks) {
-    const uint32 padding = GetPadding(retval.size(), g.alignment);
-    // TODO reuse padding
-    retval.append(padding, 0);
+  retval.resize(LayoutBlocks(sortedBlocks, &arena->pool));
 
-    std::string_view block(g.View(this));
-    newBlocks.emplace_back(Block{
-        .begin = uint32(retval.size()),
-        .end = uint32(retval.size() + block.size()),
-        .alignment = g.alignment,
-    });
-    retval.append(block);
+  for (Relocation &r : relocations) {
+    memcpy(retval.data() + r.newBegin, data.data() + r.begin, r.Size());
   }
 
-  sortedBlocks.insert(sortedBlocks.begin(), blocks.front());
-
-  for (LocalPointer &p : localPointers) {
-    for (size_t i = 0; i < sortedBlocks.size(); i++) {
-      Block &oldBlock = sortedBlocks[i];
-      Block &newBlock = newBlocks[i];
-
-      if (oldBlock.begin <= p.offset && p.offset < oldBlock.end) {
-        const uint32 offsetFromBlock = p.offset - oldBlock.begin;
+  common::ResourceBase &res =
+      reinterpret_cast<common::ResourceBase &>(retval.front());
+  res.maxAlign = maxAlign;
 
-        auto found = std::find_if(
-            sortedBlocks.begin(), sortedBlocks.end(), [&p](Block &b) {
-              return b.begin <= p.pointsTo && p.pointsTo < b.end;
-            });
+  auto FindRelocation = [&](uint32 offset) -> const Relocation * {
+    auto found = std::upper_bound(
+        relocations.begin(), relocations.end(), offset,
+        [](uint32 o, const Relocation &r) { return o < r.begin; });
 
-        uint32 newPoint =
-            newBlocks.at(std::distance(sortedBlocks.begin(), found)).begin;
-
-        if (p.size == 2) {
-          int16 *ptr = reinterpret_cast<int16 *>(
-              retval.data() + newBlock.begin + offsetFromBlock);
-          *ptr = Relative(retval.at(newPoint), *ptr);
-        } else if (p.size == 4) {
-          int32 *ptr = reinterpret_cast<int32 *>(
-              retval.data() + newBlock.begin + offsetFromBlock);
-          *ptr = Relative(retval.at(newPoint), *ptr);
-        }
-      }
+    if (found == relocations.begin()) {
+      return nullptr;
     }
-  }
 
-  return retval;
-}
+    found--;
+    return offset < found->end ? &*found : nullptr;
+  };
 
-PlayGround::BtPointer PlayGround::Allocate(uint32 size, uint32 alignment) {
-  Gap *endGap = nullptr;
+  // Both pointers and relocations are ordered by old offset, so pointer
+  // blocks are found in single pass, targets are searched
+  auto pointerBlock = relocations.begin();
 
-  for (auto &g : gaps) {
-    const uint32 startPadding = GetPadding(g.begin, alignment);
-    const uint32 alignedBegin = g.begin + startPadding;
+  for (auto &[offset, p] : localPointers) {
+    while (pointerBlock != relocations.end() && pointerBlock->end <= offset) {
+      pointerBlock++;
+    }
 
-    if (g.end == data.size()) {
-      endGap = &g;
+    if (pointerBlock == relocations.end()) {
+      break;
     }
 
-    if (alignedBegin >= g.end) {
+    if (offset < pointerBlock->begin) {
       continue;
     }
 
-    if (g.end - alignedBegin >= size) {
-      if (g.end - alignedBegin == size) {
-        if (startPadding) {
-          g.end = alignedBegin;
-          SortGaps();
-        } else {
-          // printf("removing gap [%d %d]\n", g.begin, g.end);
-          std::erase(gaps, g);
-        }
-      } else {
-        uint32 oldBegin = g.begin;
-        g.begin = alignedBegin + size;
-        // printf("change gap [%d %d] -> [%d %d]\n", oldBegin, g.end, g.begin,
-        // g.end);
-        if (startPadding) {
-          // printf("add gap [%d %d]\n", oldBegin, alignedBegin);
-          gaps.emplace_back(Gap{oldBegin, alignedBegin});
-        }
-        SortGaps();
-      }
+    const Relocation *target = FindRelocation(p.pointsTo);
 
-      // printf("add block [%d %d]\n", alignedBegin, alignedBegin + size);
-      blocks.emplace_back(Block{alignedBegin, alignedBegin + size, alignment});
-      return {alignedBegin, this};
+    if (!target) {
+      throw std::logic_error("Local pointer points outside of any block");
+    }
+
+    const uint32 newOffset =
+        pointerBlock->newBegin + (offset - pointerBlock->begin);
+    const uint32 newPoint = target->newBegin + (p.pointsTo - target->begin);
+
+    if (p.size == 2) {
+      int16 *ptr = reinterpret_cast<int16 *>(retval.data() + newOffset);
+      *ptr = Relative(retval.at(newPoint), *ptr);
+    } else if (p.size == 4) {
+      int32 *ptr = reinterpret_cast<int32 *>(retval.data() + newOffset);
+      *ptr = Relative(retval.at(newPoint), *ptr);
     }
   }
 
-  if (endGap) {
-    const uint32 gapSize = endGap->end - endGap->begin;
-    const uint32 startPadding = GetPadding(endGap->begin, alignment);
-    const uint32 alignedBegin = endGap->begin + startPadding;
+  return retval;
+}
+
+PlayGround::BtPointer PlayGround::Allocate(uint32 size, uint32 alignment) {
+  // Best fit, gaps smaller than size cannot hold item at any alignment
+  for (auto it = gapSizes.lower_bound({size, 0}); it != gapSizes.end(); it++) {
+    const uint32 begin = it->second;
+    const uint32 end = begin + it->first;
+    const uint32 startPadding = GetPadding(begin, alignment);
+    const uint32 alignedBegin = begin + startPadding;
+
+    if (alignedBegin >= end || end - alignedBegin < size) {
+      continue;
+    }
+
+    RemoveGap(gaps.find(begin));
 
     if (startPadding) {
-      endGap->end = alignedBegin;
-      SortGaps();
-    } else {
-      gaps.erase(std::next(gaps.begin(), std::distance(gaps.data(), endGap)));
+      AddGap(begin, alignedBegin);
     }
 
-    data.append(std::max(uint32(0x2000), size + startPadding) - gapSize, 0);
-    blocks.emplace_back(Block{alignedBegin, alignedBegin + size, alignment});
+    if (alignedBegin + size != end) {
+      AddGap(alignedBegin + size, end);
+    }
+
+    return AddBlock(alignedBegin, size, alignment);
+  }
+
+  // Extend data, gap at its end is reused
+  uint32 begin = data.size();
 
-    return {alignedBegin, this};
+  if (!gaps.empty() && std::prev(gaps.end())->second == begin) {
+    auto endGap = std::prev(gaps.end());
+    begin = endGap->first;
+    RemoveGap(endGap);
   }
 
-  const uint32 dataSize = data.size();
-  const uint32 startPadding = GetPadding(dataSize, alignment);
-  const uint32 alignedBegin = dataSize + startPadding;
+  const uint32 startPadding = GetPadding(begin, alignment);
+  const uint32 alignedBegin = begin + startPadding;
+  GrowData(alignedBegin + size - data.size());
+
   if (startPadding) {
-    gaps.emplace_back(Gap{dataSize, alignedBegin});
-    SortGaps();
+    AddGap(begin, alignedBegin);
   }
-  data.append(std::max(uint32(0x2000), size + startPadding), 0);
+
   if (alignedBegin + size != data.size()) {
-    gaps.emplace_back(Gap{alignedBegin + size, uint32(data.size())});
+    AddGap(alignedBegin + size, data.size());
   }
-  blocks.emplace_back(Block{alignedBegin, alignedBegin + size, alignment});
 
-  return {alignedBegin, this};
+  return AddBlock(alignedBegin, size, alignment);
+}
+
+PlayGround::BtPointer PlayGround::AddBlock(uint32 begin, uint32 size,
+                                           uint32 alignment) {
+  // printf("add block [%d %d]\n", begin, begin + size);
+  blocks.emplace(begin, Block{
+                            .begin = begin,
+                            .end = begin + size,
+                            .alignment = alignment,
+                            .order = numAllocations++,
+                        });
+  return {begin, this};
 }
 
 PlayGround::BtPointer PlayGround::Realloc(uint32 oldOffset, uint32 newSize,
                                           uint32 itemAlignment) {
-  auto found =
-      std::find_if(blocks.begin(), blocks.end(),
-                   [&](const Block &item) { return item.begin == oldOffset; });
+  auto found = blocks.find(oldOffset);
 
   assert(found != blocks.end());
 
-  auto foundGap = std::find_if(gaps.begin(), gaps.end(), [&](const Gap &gap) {
-    return gap.begin == found->end;
-  });
-
-  const uint32 oldSize = found->end - found->begin;
+  Block &block = found->second;
+  auto foundGap = gaps.find(block.end);
+  const uint32 oldSize = block.end - block.begin;
 
   if (foundGap != gaps.end()) {
-    const uint32 gapSize = foundGap->end - foundGap->begin;
+    const uint32 gapEnd = foundGap->second;
+    const uint32 gapSize = gapEnd - foundGap->first;
     const uint32 deltaSize = newSize - oldSize;
 
     if (gapSize + oldSize >= newSize) {
-      if (gapSize + oldSize == newSize) {
-        // printf("removing gap [%d %d]\n", foundGap->begin, foundGap->end);
-        std::erase(gaps, *foundGap);
-      } else {
-        // printf("change gap [%d %d] -> [%d %d]\n", foundGap->begin,
-        //       foundGap->end, foundGap->begin + deltaSize, foundGap->end);
-        foundGap->begin += deltaSize;
-        SortGaps();
+      RemoveGap(foundGap);
+
+      if (gapSize + oldSize != newSize) {
+        AddGap(block.end + deltaSize, gapEnd);
       }
 
-      // printf("change block [%d %d] -> [%d %d]\n", found->begin, found->end,
-      //        found->begin, found->end + deltaSize);
-      found->end += deltaSize;
+      // printf("change block [%d %d] -> [%d %d]\n", block.begin, block.end,
+      //        block.begin, block.end + deltaSize);
+      block.end += deltaSize;
 
       return {oldOffset, this};
     }
   }
 
-  if (found->end == data.size()) {
-    data.append(0x2000, 0);
-    found->end = found->begin + newSize;
-    gaps.emplace_back(Gap{found->end, uint32(data.size())});
+  if (block.end == data.size()) {
+    GrowData(newSize - oldSize);
+    block.end = block.begin + newSize;
+
+    if (block.end != data.size()) {
+      AddGap(block.end, data.size());
+    }
+
     return {oldOffset, this};
   }
 
-  Block thisBlock = *found;
-  std::erase(blocks, *found);
+  Block thisBlock = block;
+  blocks.erase(found);
 
   BtPointer newData = Allocate(newSize, itemAlignment);
   assert(newData.offset + newSize <= data.size());
   memcpy(data.data() + newData.offset, data.data() + thisBlock.begin, oldSize);
   NotifyDataMove(oldOffset, newData.offset, oldSize);
 
-  // printf("block to gap [%d %d]\n", found->begin, found->end);
-  gaps.emplace_back(Gap{thisBlock.begin, thisBlock.end});
-  SortGaps();
+  // printf("block to gap [%d %d]\n", thisBlock.begin, thisBlock.end);
+  AddGap(thisBlock.begin, thisBlock.end);
   return newData;
 }
 
-void PlayGround::SortGaps() {
-  std::sort(gaps.begin(), gaps.end(),
-            [](const Gap &g0, const Gap &g1) { return g0.begin < g1.begin; });
-  std::vector<Gap> oldGaps = std::move(gaps);
-  gaps.emplace_back(oldGaps.front());
-  oldGaps.erase(oldGaps.begin());
-
-  for (auto &g : oldGaps) {
-    if (g.begin == gaps.back().end) {
-      gaps.back().end = g.end;
-    } else {
-      gaps.emplace_back(g);
+void PlayGround::GrowData(uint32 minSize) {
+  // Halves number of grows for large resources, instead of fixed steps
+  const uint32 growSize =
+      std::max({uint32(0x2000), minSize, uint32(data.size() / 2)});
+  data.append(growSize, 0);
+}
+
+void PlayGround::AddGap(uint32 begin, uint32 end) {
+  auto next = gaps.lower_bound(begin);
+
+  if (next != gaps.end() && next->first == end) {
+    end = next->second;
+    RemoveGap(next++);
+  }
+
+  if (next != gaps.begin()) {
+    auto prev = std::prev(next);
+
+    if (prev->second == begin) {
+      begin = prev->first;
+      RemoveGap(prev);
     }
   }
 
-  std::sort(gaps.begin(), gaps.end(), [](const Gap &g0, const Gap &g1) {
-    return (g0.end - g0.begin) < (g1.end - g1.begin);
-  });
+  gaps.emplace_hint(next, begin, end);
+  gapSizes.emplace(end - begin, begin);
+}
+
+void PlayGround::RemoveGap(std::pmr::map<uint32, uint32>::iterator gap) {
+  gapSizes.erase({gap->second - gap->first, gap->first});
+  gaps.erase(gap);
 }
 
 void PlayGround::NotifyDataMove(uint32 oldLoc, uint32 newLoc,
                                 uint32 oldLocSize) {
-  for (BtPointer *p : pointers) {
-    if (p->offset >= oldLoc && p->offset < oldLoc + oldLocSize) {
+  const uint32 oldEnd = oldLoc + oldLocSize;
+
+  for (BtPointer *p = pointers; p; p = p->next) {
+    if (p->offset >= oldLoc && p->offset < oldEnd) {
       const uint32 deltaOffset = p->offset - oldLoc;
       p->offset = newLoc + deltaOffset;
     }
   }
 
-  for (LocalPointer &p : localPointers) {
-    if (p.offset >= oldLoc && p.offset < oldLoc + oldLocSize) {
-      if (p.size == 2) {
-        int16 *ptr = reinterpret_cast<int16 *>(data.data() + p.offset);
-        char *pointsTo = reinterpret_cast<char *>(ptr) + *ptr;
-        p.offset = p.offset - oldLoc + newLoc;
-        int16 *nPtr = reinterpret_cast<int16 *>(data.data() + p.offset);
-        *nPtr = Relative(*pointsTo, *nPtr);
-      } else if (p.size == 4) {
-        int32 *ptr = reinterpret_cast<int32 *>(data.data() + p.offset);
-        char *pointsTo = reinterpret_cast<char *>(ptr) + *ptr;
-        p.offset = p.offset - oldLoc + newLoc;
-        int32 *nPtr = reinterpret_cast<int32 *>(data.data() + p.offset);
-        *nPtr = Relative(*pointsTo, *nPtr);
-      }
+  // Pointers stored inside moved block
+  // New range does not overlap old one, so nodes are re-keyed during scan
+  for (auto it = localPointers.lower_bound(oldLoc);
+       it != localPointers.end() && it->first < oldEnd;) {
+    auto node = localPointers.extract(it++);
+    const uint32 oldOffset = node.key();
+    const uint32 newOffset = oldOffset - oldLoc + newLoc;
+    LocalPointer &p = node.mapped();
+
+    if (p.size == 2) {
+      int16 *ptr = reinterpret_cast<int16 *>(data.data() + oldOffset);
+      char *pointsTo = reinterpret_cast<char *>(ptr) + *ptr;
+      int16 *nPtr = reinterpret_cast<int16 *>(data.data() + newOffset);
+      *nPtr = Relative(*pointsTo, *nPtr);
+    } else if (p.size == 4) {
+      int32 *ptr = reinterpret_cast<int32 *>(data.data() + oldOffset);
+      char *pointsTo = reinterpret_cast<char *>(ptr) + *ptr;
+      int32 *nPtr = reinterpret_cast<int32 *>(data.data() + newOffset);
+      *nPtr = Relative(*pointsTo, *nPtr);
     }
+
+    node.key() = newOffset;
+    localPointers.insert(std::move(node));
   }
-  for (LocalPointer &p : localPointers) {
-    if (p.pointsTo >= oldLoc && p.pointsTo < oldLoc + oldLocSize) {
-      const uint32 oldPoint = p.pointsTo;
-      p.pointsTo = oldPoint - oldLoc + newLoc;
-
-      // printf("pointer %d -> %d newly points %d\n", p.offset, oldPoint,
-      //        p.pointsTo);
-
-      if (p.size == 2) {
-        int16 *ptr = reinterpret_cast<int16 *>(data.data() + p.offset);
-        *ptr = Relative(data.at(p.pointsTo), *ptr);
-      } else if (p.size == 4) {
-        int32 *ptr = reinterpret_cast<int32 *>(data.data() + p.offset);
-        *ptr = Relative(data.at(p.pointsTo), *ptr);
-      }
+
+  // Pointers to moved block
+  auto targetsBegin = pointerTargets.lower_bound({oldLoc, nullptr});
+  auto targetsEnd = pointerTargets.lower_bound({oldEnd, nullptr});
+  std::pmr::vector<LocalPointerEntry *> movedTargets(&arena->pool);
+
+  for (auto it = targetsBegin; it != targetsEnd; it++) {
+    movedTargets.push_back(it->second);
+  }
+
+  pointerTargets.erase(targetsBegin, targetsEnd);
+
+  for (LocalPointerEntry *entry : movedTargets) {
+    const uint32 offset = entry->first;
+    LocalPointer &p = entry->second;
+    [[maybe_unused]] const uint32 oldPoint = p.pointsTo;
+    p.pointsTo = oldPoint - oldLoc + newLoc;
+    pointerTargets.emplace(p.pointsTo, entry);
+
+    // printf("pointer %d -> %d newly points %d\n", offset, oldPoint,
+    //        p.pointsTo);
+
+    if (p.size == 2) {
+      int16 *ptr = reinterpret_cast<int16 *>(data.data() + offset);
+      *ptr = Relative(data.at(p.pointsTo), *ptr);
+    } else if (p.size == 4) {
+      int32 *ptr = reinterpret_cast<int32 *>(data.data() + offset);
+      *ptr = Relative(data.at(p.pointsTo), *ptr);
     }
   }
 }
@@ -284,28 +527,34 @@ void PlayGround::AddPointer(int32 *ptr) {
 
   // printf("new pointer: %d -> %d\n", offset, pointsTo);
 
-  auto found =
-      std::find_if(localPointers.begin(), localPointers.end(),
-                   [offset](LocalPointer &p) { return offset == p.offset; });
+  SetLocalPointer(offset, pointsTo, 4);
+}
+
+void PlayGround::SetLocalPointer(uint32 offset, uint32 pointsTo,
+                                 uint32 size) {
+  auto [found, inserted] = localPointers.try_emplace(
+      offset, LocalPointer{.pointsTo = pointsTo, .size = size});
 
-  if (found != localPointers.end()) {
-    found->pointsTo = pointsTo;
-  } else {
-    localPointers.emplace_back(
-        LocalPointer{.pointsTo = pointsTo, .offset = offset, .size = 4});
+  if (!inserted) {
+    pointerTargets.erase({found->second.pointsTo, &*found});
+    found->second.pointsTo = pointsTo;
   }
+
+  pointerTargets.emplace(pointsTo, &*found);
 }
 
 void PlayGround::NewString(common::String &arrayRef, std::string_view value) {
   arrayRef.asBig.length = value.size() << 1;
 
   if (value.size() > 7) {
-      Pointer<char> ptr = Allocate(value.size(), 1);
-      memcpy(ptr.operator->(), value.data(), value.size());
-      arrayRef.asBig.data = ptr.operator->();
-      AddPointer(&arrayRef.asBig.data.pointer);
-      return;
-    }
+    // Allocate can grow data, so arrayRef is tracked by offset
+    Pointer<common::String> str(Relative(arrayRef, data.front()), this);
+    Pointer<char> ptr = Allocate(value.size(), 1);
+    memcpy(ptr.operator->(), value.data(), value.size());
+    str->asBig.data = ptr.operator->();
+    AddPointer(&str->asBig.data.pointer);
+    return;
+  }
 
     arrayRef.asTiny.length |= 1;
     memcpy(arrayRef.asTiny.data , value.data(), value.size());
@@ -315,13 +564,14 @@ void PlayGround::NewCString(common::String &arrayRef, std::string_view value) {
   arrayRef.asBig.length = value.size() << 1;
 
   if (value.size() > 6) {
-      Pointer<char> ptr = Allocate(value.size() + 1, 1);
-      memcpy(ptr.operator->(), value.data(), value.size());
-      ptr.operator->()[value.size()] = '\0';
-      arrayRef.asBig.data = ptr.operator->();
-      AddPointer(&arrayRef.asBig.data.pointer);
-      return;
-    }
+    Pointer<common::String> str(Relative(arrayRef, data.front()), this);
+    Pointer<char> ptr = Allocate(value.size() + 1, 1);
+    memcpy(ptr.operator->(), value.data(), value.size());
+    ptr.operator->()[value.size()] = '\0';
+    str->asBig.data = ptr.operator->();
+    AddPointer(&str->asBig.data.pointer);
+    return;
+  }
 
     arrayRef.asTiny.length |= 1;
     memcpy(arrayRef.asTiny.data , value.data(), value.size());
@@ -0,0 +1,191 @@
+#include "utils/resource_trace.hpp"
+#include "common/flat_hash_map.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace prime::utils {
+namespace {
+struct TraceEvent {
+  common::ResourceHash hash;
+  TraceStage stage;
+  uint32 threadId;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::duration duration;
+};
+
+// Dump is cut off here, so forgotten trace does not eat all memory
+constexpr size_t MAX_TRACE_EVENTS = 1'000'000;
+
+constexpr const char *STAGE_NAMES[]{
+    "Load", "Read", "Convert", "Compile", "Process",
+};
+
+using StatsMap = common::FlatHashMap<uint32, ResourceClassStats>;
+
+// Every thread accumulates into its own table, reports merge them
+// Table lock is contended only by GetResourceStats and ResetResourceStats
+struct ThreadStats {
+  std::mutex mtx;
+  StatsMap stats;
+};
+
+std::mutex THREADS_MTX;
+std::vector<ThreadStats *> THREADS;
+// Stats of finished threads
+StatsMap RETIRED;
+
+std::mutex TRACE_MTX;
+std::atomic_bool TRACE_ENABLED;
+std::vector<TraceEvent> EVENTS;
+const auto TRACE_EPOCH = std::chrono::steady_clock::now();
+
+template <class Map>
+void Accumulate(Map &dst, const StatsMap &src) {
+  for (auto &[classHash, stats] : src) {
+    ResourceClassStats &total = dst[classHash];
+    total.bytesRead += stats.bytesRead;
+    total.numCacheHits += stats.numCacheHits;
+
+    for (size_t s = 0; s < NUM_TRACE_STAGES; s++) {
+      total.stages[s].numCalls += stats.stages[s].numCalls;
+      total.stages[s].totalNs += stats.stages[s].totalNs;
+      total.stages[s].maxNs =
+          std::max(total.stages[s].maxNs, stats.stages[s].maxNs);
+    }
+  }
+}
+
+struct ThreadStatsHolder {
+  ThreadStats stats;
+
+  ThreadStatsHolder() {
+    std::lock_guard lg(THREADS_MTX);
+    THREADS.push_back(&stats);
+  }
+
+  ~ThreadStatsHolder() {
+    std::lock_guard lg(THREADS_MTX);
+    std::erase(THREADS, &stats);
+    Accumulate(RETIRED, stats.stats);
+  }
+};
+
+ThreadStats &LocalStats() {
+  static thread_local ThreadStatsHolder holder;
+  return holder.stats;
+}
+
+uint32 ThreadId() {
+  static std::atomic<uint32> lastId;
+  static thread_local const uint32 id = ++lastId;
+  return id;
+}
+} // namespace
+
+std::map<uint32, ResourceClassStats> GetResourceStats() {
+  std::map<uint32, ResourceClassStats> retVal;
+  std::lock_guard lg(THREADS_MTX);
+  Accumulate(retVal, RETIRED);
+
+  for (ThreadStats *t : THREADS) {
+    std::lock_guard tlg(t->mtx);
+    Accumulate(retVal, t->stats);
+  }
+
+  return retVal;
+}
+
+void ResetResourceStats() {
+  std::lock_guard lg(THREADS_MTX);
+  RETIRED.clear();
+
+  for (ThreadStats *t : THREADS) {
+    std::lock_guard tlg(t->mtx);
+    t->stats.clear();
+  }
+}
+
+void RecordStage(common::ResourceHash hash, TraceStage stage,
+                 std::chrono::steady_clock::time_point begin,
+                 std::chrono::steady_clock::time_point end) {
+  const uint64 ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+          .count();
+  ThreadStats &local = LocalStats();
+
+  {
+    std::lock_guard lg(local.mtx);
+    StageStats &stats = local.stats[hash.type].stages[size_t(stage)];
+    stats.numCalls++;
+    stats.totalNs += ns;
+    stats.maxNs = std::max(stats.maxNs, ns);
+  }
+
+  if (TRACE_ENABLED.load(std::memory_order_relaxed)) {
+    std::lock_guard lg(TRACE_MTX);
+
+    if (EVENTS.size() < MAX_TRACE_EVENTS) {
+      EVENTS.push_back({hash, stage, ThreadId(), begin, end - begin});
+    }
+  }
+}
+
+void RecordBytesRead(uint32 classHash, size_t numBytes) {
+  ThreadStats &local = LocalStats();
+  std::lock_guard lg(local.mtx);
+  local.stats[classHash].bytesRead += numBytes;
+}
+
+void RecordCacheHit(uint32 classHash) {
+  ThreadStats &local = LocalStats();
+  std::lock_guard lg(local.mtx);
+  local.stats[classHash].numCacheHits++;
+}
+
+void EnableResourceTrace(bool enable) { TRACE_ENABLED = enable; }
+
+bool DumpResourceTrace(const std::string &path) {
+  std::vector<TraceEvent> events;
+
+  {
+    std::lock_guard lg(TRACE_MTX);
+    std::swap(events, EVENTS);
+  }
+
+  std::ofstream str(path);
+
+  if (!str) {
+    return false;
+  }
+
+  auto ToMicroseconds = [](std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+
+  str << "{\"traceEvents\":[";
+  char buffer[256];
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent &e = events[i];
+    // Complete event, hashes are printed as hex so they can be matched
+    // against ResourceDebug and cache listings
+    snprintf(buffer, sizeof(buffer),
+             "%s\n{\"name\":\"%08X:%08X\",\"cat\":\"%s\",\"ph\":\"X\","
+             "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+             i ? "," : "", e.hash.type, e.hash.name,
+             STAGE_NAMES[size_t(e.stage)],
+             ToMicroseconds(e.begin - TRACE_EPOCH),
+             ToMicroseconds(e.duration), e.threadId);
+    str << buffer;
+  }
+
+  str << "\n]}\n";
+
+  return bool(str);
+}
+} // namespace prime::utils
@@ -0,0 +1,394 @@
+#include "utils/scan_tree.hpp"
+#include "utils/thread_pool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ctime>
+#include <fstream>
+#include <span>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace prime::utils {
+namespace {
+// Kernel record of getdents64, glibc does not expose it everywhere
+struct LinuxDirent64 {
+  uint64_t ino;
+  int64_t off;
+  unsigned short reclen;
+  unsigned char type;
+  char name[];
+};
+
+// Entry names of single folder, path set of folder can change only together
+// with folder mtime
+struct IndexedFolder {
+  int64_t mtime = 0;
+  std::vector<std::string> files;
+  std::vector<std::string> folders;
+};
+
+// Folders keyed by path relative to scan root
+using TreeIndex = std::unordered_map<std::string, IndexedFolder>;
+
+constexpr uint32_t INDEX_ID = 0x58495450; // PTIX
+constexpr uint32_t INDEX_VERSION = 1;
+constexpr int64_t RACY_PERIOD = 2'000'000'000;
+
+int64_t ToNanoseconds(const timespec &time) {
+  return time.tv_sec * 1'000'000'000 + time.tv_nsec;
+}
+
+struct ScanState {
+  std::mutex mtx;
+  std::condition_variable signal;
+  // Used as stack, keeps walk depth first and working set small
+  std::vector<std::string> folders;
+  // Folders queued or being read
+  size_t numPending = 0;
+  const std::string &root;
+  const ScanCallback &onFolder;
+  const ScanCallback &onFile;
+  // Only for indexed scan
+  const TreeIndex *index = nullptr;
+  std::vector<TreeIndex> scanned;
+  std::atomic_bool changed = false;
+  int64_t startTime = 0;
+
+  ScanState(const std::string &root_, const ScanCallback &onFolder_,
+            const ScanCallback &onFile_)
+      : folders{root_}, numPending(1), root(root_), onFolder(onFolder_),
+        onFile(onFile_) {}
+};
+
+bool IsFolder(int dirFd, const LinuxDirent64 &entry) {
+  if (entry.type != DT_UNKNOWN) {
+    return entry.type == DT_DIR;
+  }
+
+  // Some filesystems do not fill d_type
+  struct stat st;
+  return fstatat(dirFd, entry.name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+         S_ISDIR(st.st_mode);
+}
+
+void ReadFolder(ScanState &state, const std::string &path,
+                std::vector<std::string> &subFolders, size_t worker,
+                IndexedFolder *record) {
+  const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  if (fd < 0) {
+    return;
+  }
+
+  alignas(LinuxDirent64) char buffer[0x8000];
+  std::string absPath;
+
+  for (long rdLen;
+       (rdLen = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0;) {
+    for (long cb = 0; cb < rdLen;) {
+      const LinuxDirent64 &entry =
+          *reinterpret_cast<const LinuxDirent64 *>(buffer + cb);
+      cb += entry.reclen;
+      const std::string_view name(entry.name);
+
+      if (name == "." || name == ".." || name == ".prime") {
+        continue;
+      }
+
+      absPath.assign(path);
+      absPath.push_back('/');
+      absPath.append(name);
+
+      if (IsFolder(fd, entry)) {
+        subFolders.emplace_back(absPath);
+
+        if (record) {
+          record->folders.emplace_back(name);
+        }
+      } else {
+        state.onFile(absPath, worker);
+
+        if (record) {
+          record->files.emplace_back(name);
+        }
+      }
+    }
+  }
+
+  close(fd);
+}
+
+// Serves folder from index when its mtime did not change
+void ReadFolderIndexed(ScanState &state, const std::string &path,
+                       std::vector<std::string> &subFolders, size_t worker) {
+  struct stat st;
+
+  if (stat(path.c_str(), &st) < 0) {
+    state.changed = true;
+    return;
+  }
+
+  std::string localPath = path.substr(state.root.size());
+  IndexedFolder record;
+  // Taken before reading, change during read is caught on next scan
+  record.mtime = ToNanoseconds(st.st_mtim);
+
+  if (auto found = state.index->find(localPath);
+      found != state.index->end() && found->second.mtime == record.mtime) {
+    std::string absPath;
+
+    for (auto &f : found->second.files) {
+      absPath.assign(path);
+      absPath.push_back('/');
+      absPath.append(f);
+      state.onFile(absPath, worker);
+    }
+
+    for (auto &f : found->second.folders) {
+      subFolders.emplace_back(path + '/' + f);
+    }
+
+    state.scanned[worker].emplace(std::move(localPath), found->second);
+    return;
+  }
+
+  state.changed = true;
+  ReadFolder(state, path, subFolders, worker, &record);
+
+  // Mtime has coarse granularity, folder changed after reading could still
+  // end up with same mtime, such folder is read again on next scan
+  if (record.mtime + RACY_PERIOD > state.startTime) {
+    record.mtime = 0;
+  }
+
+  state.scanned[worker].emplace(std::move(localPath), std::move(record));
+}
+
+void Work(ScanState &state, size_t worker) {
+  std::vector<std::string> subFolders;
+  std::unique_lock lk(state.mtx);
+
+  while (true) {
+    state.signal.wait(lk, [&] {
+      return !state.folders.empty() || state.numPending == 0;
+    });
+
+    if (state.folders.empty()) {
+      return;
+    }
+
+    std::string folder = std::move(state.folders.back());
+    state.folders.pop_back();
+    lk.unlock();
+
+    state.onFolder(folder, worker);
+
+    if (state.index) {
+      ReadFolderIndexed(state, folder, subFolders, worker);
+    } else {
+      ReadFolder(state, folder, subFolders, worker, nullptr);
+    }
+
+    lk.lock();
+    state.numPending += subFolders.size();
+    state.numPending--;
+
+    for (auto &s : subFolders) {
+      state.folders.emplace_back(std::move(s));
+    }
+
+    if (!subFolders.empty() || state.numPending == 0) {
+      state.signal.notify_all();
+    }
+
+    subFolders.clear();
+  }
+}
+
+void RunWorkers(ScanState &state) {
+  std::vector<std::future<void>> tasks;
+
+  for (size_t i = 1; i < NumScanWorkers(); i++) {
+    tasks.emplace_back(WorkerPool().Enqueue([&state, i] { Work(state, i); }));
+  }
+
+  Work(state, 0);
+
+  for (auto &t : tasks) {
+    t.wait();
+  }
+}
+
+// Layout: id, version, numFolders, then for each folder mtime, path,
+// numFiles, numFolders and entry names, strings are prefixed by uint32 size
+struct IndexReader {
+  std::string_view data;
+
+  template <class C> bool Read(C &value) {
+    if (data.size() < sizeof(C)) {
+      return false;
+    }
+
+    memcpy(&value, data.data(), sizeof(C));
+    data.remove_prefix(sizeof(C));
+    return true;
+  }
+
+  bool Read(std::string &value) {
+    uint32_t size;
+
+    if (!Read(size) || data.size() < size) {
+      return false;
+    }
+
+    value.assign(data.substr(0, size));
+    data.remove_prefix(size);
+    return true;
+  }
+
+  bool Read(std::vector<std::string> &values) {
+    uint32_t size;
+
+    if (!Read(size) || data.size() < size * sizeof(uint32_t)) {
+      return false;
+    }
+
+    values.resize(size);
+
+    for (auto &v : values) {
+      if (!Read(v)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+// Missing or damaged index is returned empty
+TreeIndex LoadIndex(const std::string &indexPath) {
+  std::ifstream str(indexPath, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(str)),
+                   std::istreambuf_iterator<char>());
+  IndexReader rd{data};
+  uint32_t id = 0;
+  uint32_t version = 0;
+  uint32_t numFolders = 0;
+  TreeIndex retVal;
+
+  if (!rd.Read(id) || id != INDEX_ID || !rd.Read(version) ||
+      version != INDEX_VERSION || !rd.Read(numFolders)) {
+    return retVal;
+  }
+
+  // Each folder takes at least 20 bytes
+  if (numFolders > rd.data.size() / 20) {
+    return retVal;
+  }
+
+  retVal.reserve(numFolders);
+
+  for (uint32_t i = 0; i < numFolders; i++) {
+    std::string path;
+    IndexedFolder folder;
+
+    if (!rd.Read(folder.mtime) || !rd.Read(path) || !rd.Read(folder.files) ||
+        !rd.Read(folder.folders)) {
+      return {};
+    }
+
+    retVal.emplace(std::move(path), std::move(folder));
+  }
+
+  return retVal;
+}
+
+void WriteString(std::ostream &str, std::string_view value) {
+  const uint32_t size = value.size();
+  str.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  str.write(value.data(), size);
+}
+
+void WriteStrings(std::ostream &str, const std::vector<std::string> &values) {
+  const uint32_t size = values.size();
+  str.write(reinterpret_cast<const char *>(&size), sizeof(size));
+
+  for (auto &v : values) {
+    WriteString(str, v);
+  }
+}
+
+// Written to temporary file first, so reader never sees partial index
+void SaveIndex(const std::string &indexPath, std::span<TreeIndex> scanned) {
+  const std::string tmpPath = indexPath + ".tmp";
+  std::ofstream str(tmpPath, std::ios::binary | std::ios::trunc);
+
+  if (!str) {
+    return;
+  }
+
+  uint32_t numFolders = 0;
+
+  for (auto &s : scanned) {
+    numFolders += s.size();
+  }
+
+  str.write(reinterpret_cast<const char *>(&INDEX_ID), sizeof(INDEX_ID));
+  str.write(reinterpret_cast<const char *>(&INDEX_VERSION),
+            sizeof(INDEX_VERSION));
+  str.write(reinterpret_cast<const char *>(&numFolders), sizeof(numFolders));
+
+  for (auto &s : scanned) {
+    for (auto &[path, folder] : s) {
+      str.write(reinterpret_cast<const char *>(&folder.mtime),
+                sizeof(folder.mtime));
+      WriteString(str, path);
+      WriteStrings(str, folder.files);
+      WriteStrings(str, folder.folders);
+    }
+  }
+
+  str.close();
+
+  if (!str || rename(tmpPath.c_str(), indexPath.c_str()) < 0) {
+    unlink(tmpPath.c_str());
+  }
+}
+} // namespace
+
+size_t NumScanWorkers() { return WorkerPool().NumThreads() + 1; }
+
+void ScanTree(const std::string &root, const ScanCallback &onFolder,
+              const ScanCallback &onFile) {
+  ScanState state(root, onFolder, onFile);
+  RunWorkers(state);
+}
+
+void ScanTree(const std::string &root, const std::string &indexPath,
+              const ScanCallback &onFolder, const ScanCallback &onFile) {
+  const TreeIndex index = LoadIndex(indexPath);
+  ScanState state(root, onFolder, onFile);
+  state.index = &index;
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  state.startTime = ToNanoseconds(now);
+  state.scanned.resize(NumScanWorkers());
+  RunWorkers(state);
+
+  size_t numScanned = 0;
+
+  for (auto &s : state.scanned) {
+    numScanned += s.size();
+  }
+
+  // Index may hold folders that are no longer reachable
+  if (state.changed || numScanned != index.size()) {
+    SaveIndex(indexPath, state.scanned);
+  }
+}
+} // namespace prime::utils
@@ -10,8 +10,6 @@
 #define GL_VERTEX_SHADER 0x8B31
 #define GL_GEOMETRY_SHADER 0x8DD9
 
-static std::map<uint32, std::set<prime::common::ResourceHash>> REFERENCES;
-
 namespace prime::graphics {
 class StageObject;
 }
@@ -19,11 +17,17 @@ class StageObject;
 HASH_CLASS(prime::graphics::StageObject);
 
 namespace prime::utils {
-std::string PreProcess(common::ResourceHash object, simplecpp::DUI &dui) {
+common::Return<std::string> PreProcess(common::ResourceHash object,
+                                       simplecpp::DUI &dui) {
+  auto res = common::TryLoadResource(object);
+
+  if (res.status) {
+    return {res.status, {}};
+  }
+
   simplecpp::OutputList outputList;
   std::vector<std::string> files;
-  auto &res = common::LoadResource(object);
-  std::stringstream iStr(res.buffer);
+  std::stringstream iStr{std::string(res.retVal->buffer)};
   simplecpp::TokenList rawtokens(iStr, files, {}, &outputList);
   auto included = simplecpp::load(rawtokens, files, dui, &outputList);
   simplecpp::TokenList outputTokens(files);
@@ -63,15 +67,16 @@ std::string PreProcess(common::ResourceHash object, simplecpp::DUI &dui) {
   }
 
   const std::string includePath = dui.includePaths.front();
-  REFERENCES[object.name].emplace(
-      common::MakeHash<graphics::StageObject>(object.name));
+  const auto stage = common::MakeHash<graphics::StageObject>(object.name);
+  common::AddReloadDependency(object, stage);
 
   for (auto &[path_, data] : included) {
     std::string_view path(path_);
     path.remove_prefix(includePath.size());
-    const common::ResourceHash pathHash(common::MakeHash<char>(path));
-    REFERENCES[pathHash.name].emplace(
-        common::MakeHash<graphics::StageObject>(object.name));
+    // Same hash as working folder watcher gives to files without class
+    const common::ResourceHash pathHash(
+        JenkinsHash3_({path.data(), path.size()}), 0);
+    common::AddReloadDependency(pathHash, stage);
   }
 
   std::ostringstream ret;
@@ -96,11 +101,12 @@ std::string PreProcess(common::ResourceHash object, simplecpp::DUI &dui) {
 
   simplecpp::cleanup(included);
 
-  return std::move(ret).str();
+  return {NO_ERROR, std::move(ret).str()};
 }
 
-std::string PreprocessShader(JenHash3 object, uint16 target,
-                             std::span<std::string_view> definitions) {
+common::Return<std::string>
+PreprocessShader(JenHash3 object, uint16 target,
+                 std::span<std::string_view> definitions) {
   common::ResourceHash resource(object);
   simplecpp::DUI dui;
   dui.defines.emplace_back("SHADER");
@@ -136,41 +142,4 @@ std::string PreprocessShader(JenHash3 object, uint16 target,
 
   return PreProcess(resource, dui);
 }
-
-class ShaderPreprocessor;
 } // namespace prime::utils
-
-HASH_CLASS(prime::utils::ShaderPreprocessor)
-
-template <> class prime::common::InvokeGuard<prime::utils::ShaderPreprocessor> {
-  static inline const bool data =
-      prime::common::AddResourceHandle<prime::utils::ShaderPreprocessor>({
-          .Process = nullptr,
-          .Delete = nullptr,
-          .Update =
-              [](ResourceHash hash) {
-                if (hash.type > 0) {
-                  return;
-                }
-
-                if (REFERENCES.contains(hash.name)) {
-                  common::LoadResource(common::MakeHash<char>(hash.name), true);
-                  auto &refs = REFERENCES.at(hash.name);
-                  for (auto &ref : refs) {
-                    GetClassHandle(ref.type)
-                        .Success([&](const ResourceHandle *item) {
-                          item->Update(ref);
-                        })
-                        .Unused();
-                  }
-                } else {
-                  GetClassHandle(common::GetClassHash<graphics::StageObject>())
-                      .Success([&](const ResourceHandle *item) {
-                        item->Update(
-                            common::MakeHash<graphics::StageObject>(hash.name));
-                      })
-                      .Unused();
-                }
-              },
-      });
-};
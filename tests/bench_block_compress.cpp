@@ -0,0 +1,84 @@
+#include "ispc_texcomp.h"
+#include "utils/converters/block_compress.hpp"
+#include "utils/thread_pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace pu = prime::utils;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct FormatInfo {
+  pu::BlockFormat format;
+  const char *name;
+  // Bytes per input pixel
+  uint32 pixelSize;
+};
+
+constexpr FormatInfo FORMATS[]{
+    {pu::BlockFormat::BC1, "BC1", 4},  {pu::BlockFormat::BC3, "BC3", 4},
+    {pu::BlockFormat::BC4, "BC4", 1},  {pu::BlockFormat::BC5, "BC5", 2},
+    {pu::BlockFormat::BC5S, "BC5S", 2}, {pu::BlockFormat::BC7, "BC7", 4},
+};
+
+// Noisy gradient, flat data would make BC7 mode search unrealistically fast
+std::vector<uint8_t> MakeImage(uint32 size) {
+  std::vector<uint8_t> retVal(size * size * 4);
+  uint32 seed = 1;
+
+  for (uint32 y = 0; y < size; y++) {
+    for (uint32 x = 0; x < size; x++) {
+      seed = seed * 1664525 + 1013904223;
+      uint8_t *pixel = &retVal[(y * size + x) * 4];
+      pixel[0] = x * 255 / size + (seed >> 28);
+      pixel[1] = y * 255 / size + (seed >> 24 & 0xf);
+      pixel[2] = (x + y) * 127 / size;
+      pixel[3] = seed >> 16;
+    }
+  }
+
+  return retVal;
+}
+
+// Megapixels per second
+double Compress(const FormatInfo &info, std::vector<uint8_t> &image,
+                uint32 size, uint32 numThreads, std::string &output) {
+  rgba_surface surf{
+      .ptr = image.data(),
+      .width = int32_t(size),
+      .height = int32_t(size),
+      .stride = int32_t(size * info.pixelSize),
+  };
+  bc7_enc_settings prof;
+  GetProfile_alpha_basic(&prof);
+
+  auto startTime = Clock::now();
+  output = pu::CompressBlocks(surf, info.format, &prof, numThreads);
+  auto endTime = Clock::now();
+
+  const double seconds = std::chrono::duration<double>(endTime - startTime)
+                             .count();
+  return size * size / seconds / 1'000'000;
+}
+
+int main() {
+  constexpr uint32 SIZE = 2048;
+  std::vector<uint8_t> image = MakeImage(SIZE);
+  const uint32 numThreads = pu::WorkerPool().NumThreads() + 1;
+
+  printf("%ux%u, %u threads\n", SIZE, SIZE, numThreads);
+
+  for (const FormatInfo &info : FORMATS) {
+    std::string single;
+    std::string multi;
+    const double singleRate = Compress(info, image, SIZE, 1, single);
+    const double multiRate = Compress(info, image, SIZE, 0, multi);
+
+    printf("%-5s 1 thread %8.1f MPix/s, %u threads %8.1f MPix/s, %.1fx%s\n",
+           info.name, singleRate, numThreads, multiRate,
+           multiRate / singleRate, single == multi ? "" : ", MISMATCH");
+  }
+
+  return 0;
+}
@@ -0,0 +1,284 @@
+#include "utils/playground.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace pu = prime::utils;
+namespace pc = prime::common;
+
+struct BenchItem {
+  pc::String name;
+  uint32 index;
+  pc::LocalArray32<uint32> values;
+};
+
+HASH_CLASS(BenchItem);
+
+// Mimics script FuncProto literals
+struct BenchLiteralString {
+  uint64 hash;
+  uint32 length;
+  char value[4];
+};
+
+HASH_CLASS(BenchLiteralString);
+
+struct BenchLiteral {
+  uint32 type;
+  pc::LocalPointer<BenchLiteralString> pString;
+};
+
+HASH_CLASS(BenchLiteral);
+
+struct BenchProto {
+  pc::ResourceBase base;
+  pc::LocalArray32<BenchLiteral> literals;
+  pc::LocalArray32<pc::String> names;
+};
+
+struct BenchRoot {
+  pc::LocalArray32<BenchItem> items;
+  pc::LocalArray32<uint32> numbers;
+};
+
+// Mimics converted texture header
+struct BenchTexture {
+  pc::ResourceBase base;
+  uint32 width;
+  uint32 height;
+  pc::LocalArray32<uint32> mipOffsets;
+  pc::LocalArray32<uint32> mipSizes;
+};
+
+// Mimics ResourceDebug dependencies
+struct BenchDependency {
+  pc::String path;
+  pc::LocalArray32<uint32> types;
+};
+
+HASH_CLASS(BenchDependency);
+
+struct BenchDebug {
+  pc::LocalArray32<BenchDependency> dependencies;
+};
+
+using Clock = std::chrono::high_resolution_clock;
+
+size_t NUM_ALLOCATIONS = 0;
+
+void *operator new(size_t size) {
+  NUM_ALLOCATIONS++;
+
+  if (void *ptr = malloc(size)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+double Millis(Clock::duration dur) {
+  return std::chrono::duration<double, std::milli>(dur).count();
+}
+
+void FillArrays(uint32 numItems) {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<BenchRoot> root = pg.AddClass<BenchRoot>();
+  char name[32];
+
+  auto startTime = Clock::now();
+
+  for (uint32 i = 0; i < numItems; i++) {
+    pg.ArrayEmplace(root->items)->index = i;
+  }
+
+  for (uint32 i = 0; i < numItems; i++) {
+    pg.ArrayEmplace(root->numbers, i);
+  }
+
+  auto arraysTime = Clock::now();
+
+  // Every long string adds block and local pointer
+  for (uint32 i = 0; i < numItems; i++) {
+    const int nameSize = snprintf(name, sizeof(name), "bench item %u", i);
+    pg.NewString(root->items[i].name, std::string_view(name, nameSize));
+  }
+
+  auto stringsTime = Clock::now();
+
+  // Moves items array together with all its local pointers
+  pg.ArrayEmplace(root->items)->index = numItems;
+
+  auto endTime = Clock::now();
+
+  for (uint32 i = 0; i < numItems; i++) {
+    snprintf(name, sizeof(name), "bench item %u", i);
+    if (std::string_view(root->items[i].name) != name ||
+        root->items[i].index != i || root->numbers[i] != i) {
+      printf("Invalid item %u\n", i);
+      break;
+    }
+  }
+
+  printf("%6u items: arrays %.1fms, strings %.1fms, move %.2fms\n", numItems,
+         Millis(arraysTime - startTime), Millis(stringsTime - arraysTime),
+         Millis(endTime - stringsTime));
+}
+
+// Many small arrays growing in turns keep moving around,
+// which leaves lots of gaps behind
+void FragmentArrays(uint32 numItems, uint32 numValues) {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<BenchRoot> root = pg.AddClass<BenchRoot>();
+
+  for (uint32 i = 0; i < numItems; i++) {
+    pg.ArrayEmplace(root->items)->index = i;
+  }
+
+  auto startTime = Clock::now();
+
+  for (uint32 v = 0; v < numValues; v++) {
+    for (uint32 i = 0; i < numItems; i++) {
+      pg.ArrayEmplace(root->items[i].values, v);
+    }
+  }
+
+  auto endTime = Clock::now();
+
+  for (uint32 i = 0; i < numItems; i++) {
+    if (root->items[i].values.numItems != numValues ||
+        root->items[i].values[numValues - 1] != numValues - 1) {
+      printf("Invalid item %u\n", i);
+      break;
+    }
+  }
+
+  printf("%6u arrays x %u values: %.1fms\n", numItems, numValues,
+         Millis(endTime - startTime));
+}
+
+void BuildProto(uint32 numLiterals) {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<BenchProto> proto = pg.AddClass<BenchProto>();
+  char buffer[64]{};
+
+  for (uint32 i = 0; i < numLiterals; i++) {
+    pu::PlayGround::Pointer<BenchLiteral> lit =
+        pg.ArrayEmplace(proto->literals);
+    lit->type = 1;
+    BenchLiteralString *str = reinterpret_cast<BenchLiteralString *>(buffer);
+    str->hash = i;
+    str->length = snprintf(str->value, 40, "%.*s%u", int(i % 17),
+                           "literal_value_text", i);
+    pu::PlayGround::Pointer<BenchLiteralString> ls =
+        pg.NewBytes<BenchLiteralString>(buffer, 12 + str->length + 1);
+    pg.Link(lit->pString, ls.operator->());
+
+    const int nameSize = snprintf(buffer, sizeof(buffer), "%.*s%u",
+                                  int(i % 13), "local_variable", i);
+    pg.NewCString(*pg.ArrayEmplace(proto->names),
+                  std::string_view(buffer, nameSize));
+  }
+
+  auto startTime = Clock::now();
+  std::string built = pg.Build();
+  auto endTime = Clock::now();
+
+  BenchProto *builtProto = reinterpret_cast<BenchProto *>(built.data());
+
+  for (uint32 i = 0; i < numLiterals; i++) {
+    if (builtProto->literals[i].pString->hash != i) {
+      printf("Invalid literal %u\n", i);
+      break;
+    }
+  }
+
+  printf("%6u literals: build %.2fms, %zu bytes\n", numLiterals,
+         Millis(endTime - startTime), built.size());
+}
+
+void ConvertTexture(pu::PlayGround &pg, pu::PlayGround &dbg, uint32 index) {
+  pu::PlayGround::Pointer<BenchTexture> tex = pg.AddClass<BenchTexture>();
+  tex->width = 256;
+  tex->height = 256;
+
+  for (uint32 m = 0; m < 9; m++) {
+    pg.ArrayEmplace(tex->mipOffsets, m * 0x1000);
+    pg.ArrayEmplace(tex->mipSizes, 0x1000u >> m);
+  }
+
+  pu::PlayGround::Pointer<BenchDebug> debug = dbg.AddClass<BenchDebug>();
+  char path[64];
+
+  for (uint32 d = 0; d < 4; d++) {
+    pu::PlayGround::Pointer<BenchDependency> dep =
+        dbg.ArrayEmplace(debug->dependencies);
+    const int pathSize = snprintf(path, sizeof(path),
+                                  "textures/batch/texture_%u_%u.png", index, d);
+    dbg.NewString(dep->path, std::string_view(path, pathSize));
+    dbg.ArrayEmplace(dep->types, d);
+  }
+
+  std::string built = pg.Build();
+  built.append(dbg.Build());
+}
+
+// Every conversion creates its own playgrounds, like gltex does per file
+void BatchConvert(uint32 numFiles) {
+  const size_t startAllocations = NUM_ALLOCATIONS;
+  auto startTime = Clock::now();
+
+  for (uint32 i = 0; i < numFiles; i++) {
+    pu::PlayGround pg;
+    pu::PlayGround dbg;
+    ConvertTexture(pg, dbg, i);
+  }
+
+  auto endTime = Clock::now();
+
+  printf("%6u files: %.1fms, %zu allocations\n", numFiles,
+         Millis(endTime - startTime), NUM_ALLOCATIONS - startAllocations);
+}
+
+// Same playgrounds reset between conversions
+void BatchConvertReset(uint32 numFiles) {
+  const size_t startAllocations = NUM_ALLOCATIONS;
+  auto startTime = Clock::now();
+  pu::PlayGround pg;
+  pu::PlayGround dbg;
+
+  for (uint32 i = 0; i < numFiles; i++) {
+    pg.Reset();
+    dbg.Reset();
+    ConvertTexture(pg, dbg, i);
+  }
+
+  auto endTime = Clock::now();
+
+  printf("%6u files with reset: %.1fms, %zu allocations\n", numFiles,
+         Millis(endTime - startTime), NUM_ALLOCATIONS - startAllocations);
+}
+
+int main() {
+  for (uint32 numItems : {1'000, 10'000, 100'000}) {
+    FillArrays(numItems);
+  }
+
+  for (uint32 numItems : {1'000, 10'000}) {
+    FragmentArrays(numItems, 16);
+  }
+
+  for (uint32 numLiterals : {1'000, 10'000, 50'000}) {
+    BuildProto(numLiterals);
+  }
+
+  for (uint32 numFiles : {1'000, 10'000}) {
+    BatchConvert(numFiles);
+    BatchConvertReset(numFiles);
+  }
+
+  return 0;
+}
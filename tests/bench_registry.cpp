@@ -0,0 +1,69 @@
+#include "common/core.hpp"
+#include "common/perfect_hash_map.hpp"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+
+using namespace prime::common;
+
+template <class F> double MeasureLookup(const std::vector<ExtString> &queries,
+                                        F &&lookup) {
+  uint64 checksum = 0;
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  for (auto &q : queries) {
+    checksum += lookup(q);
+  }
+
+  auto dur = std::chrono::high_resolution_clock::now() - startTime;
+
+  if (checksum == 0) {
+    printf("Invalid checksum\n");
+  }
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() /
+         double(queries.size());
+}
+
+int main() {
+  constexpr size_t NUM_QUERIES = 10'000'000;
+  std::mt19937_64 rng(0x5eed);
+
+  for (size_t numClasses : {16, 64, 256}) {
+    std::map<ExtString, uint32> map;
+    std::vector<std::pair<uint64, uint32>> items;
+
+    while (map.size() < numClasses) {
+      std::string ext;
+
+      for (size_t i = 0; i < 3 + rng() % 4; i++) {
+        ext.push_back('a' + rng() % 26);
+      }
+
+      const uint32 hash = JenkinsHash_(ext);
+
+      if (map.emplace(ExtString(ext), hash).second) {
+        items.emplace_back(ExtString(ext).raw, hash);
+      }
+    }
+
+    PerfectHashMap<uint64, uint32> perfect(items);
+    std::vector<ExtString> queries(NUM_QUERIES);
+
+    for (auto &q : queries) {
+      q = items[rng() % items.size()].first;
+    }
+
+    const double mapTime = MeasureLookup(
+        queries, [&](ExtString key) { return map.find(key)->second; });
+    const double perfectTime = MeasureLookup(
+        queries, [&](ExtString key) { return *perfect.find(key.raw); });
+
+    printf("%zu classes: std::map %.2fns, PerfectHashMap %.2fns, %.1fx\n",
+           numClasses, mapTime, perfectTime, mapTime / perfectTime);
+  }
+
+  return 0;
+}
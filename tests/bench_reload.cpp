@@ -0,0 +1,120 @@
+#include "common/resource.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace pc = prime::common;
+
+namespace prime::common {
+struct BenchShader;
+}
+
+CLASS_EXT(prime::common::BenchShader);
+REGISTER_CLASS(prime::common::BenchShader);
+
+static std::atomic_size_t NUM_UPDATED;
+
+static void WriteFile(const std::string &path, const std::string &data) {
+  const int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  [[maybe_unused]] auto written = write(fd, data.data(), data.size());
+  close(fd);
+}
+
+// Include shared by every stage, every program links few stages
+// Saving include updates include, all stages and all programs
+int main(int argc, char **argv) {
+  const size_t numStages = argc > 1 ? atoi(argv[1]) : 500;
+  const size_t stagesPerProgram = 4;
+  char root[] = "/tmp/bench_reload_XXXXXX";
+
+  if (!mkdtemp(root)) {
+    printf("Failed to create temporary folder\n");
+    return 1;
+  }
+
+  const std::string ext(pc::GetClassExtension<pc::BenchShader>());
+  const std::string includePath = std::string(root) + "/common." + ext;
+  WriteFile(includePath, "// common");
+
+  for (size_t i = 0; i < numStages; i++) {
+    WriteFile(std::string(root) + "/stage" + std::to_string(i) + "." + ext,
+              "#include \"common\"");
+  }
+
+  pc::AddResourceHandle<pc::BenchShader>({
+      .Process = [](pc::ResourceData &) {},
+      .Delete = nullptr,
+      .Update = [](pc::ResourceHash) { NUM_UPDATED++; },
+  });
+  pc::AddWorkingFolder(std::string(root) + "/");
+
+  const pc::ResourceHash include = pc::MakeHash<pc::BenchShader>("common");
+  size_t numPrograms = 0;
+
+  for (size_t i = 0; i < numStages; i++) {
+    const pc::ResourceHash stage =
+        pc::MakeHash<pc::BenchShader>("stage" + std::to_string(i));
+    pc::AddReloadDependency(include, stage);
+
+    if (i % stagesPerProgram == 0) {
+      numPrograms++;
+    }
+
+    pc::AddReloadDependency(
+        stage, pc::MakeHash<pc::BenchShader>("program" +
+                                             std::to_string(numPrograms)));
+  }
+
+  const size_t numExpected = 1 + numStages + numPrograms;
+  printf("%zu stages, %zu programs\n", numStages, numPrograms);
+  std::vector<double> latencies;
+  std::vector<double> dispatches;
+
+  for (int i = 0; i < 20; i++) {
+    NUM_UPDATED = 0;
+    const auto saveTime = std::chrono::steady_clock::now();
+    WriteFile(includePath, "// common " + std::to_string(i));
+    double dispatchTime = 0;
+
+    while (NUM_UPDATED < numExpected) {
+      const auto pollBegin = std::chrono::steady_clock::now();
+      pc::PollUpdates();
+      dispatchTime = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - pollBegin)
+                         .count();
+
+      if (std::chrono::steady_clock::now() - saveTime >
+          std::chrono::seconds(5)) {
+        printf("Timed out with %zu of %zu updates\n", NUM_UPDATED.load(),
+               numExpected);
+        return 1;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    latencies.push_back(std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - saveTime)
+                            .count());
+    dispatches.push_back(dispatchTime);
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  std::sort(dispatches.begin(), dispatches.end());
+  // Save to update includes watcher debounce of 50ms
+  printf("save to update: min %.2fms median %.2fms\n", latencies.front(),
+         latencies[latencies.size() / 2]);
+  printf("dispatch of %zu updates: min %.3fms median %.3fms\n", numExpected,
+         dispatches.front(), dispatches[dispatches.size() / 2]);
+
+  std::string cmd("rm -rf ");
+  cmd.append(root);
+  return system(cmd.c_str());
+}
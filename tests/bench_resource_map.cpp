@@ -0,0 +1,63 @@
+#include "common/flat_hash_map.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+
+using namespace prime::common;
+
+struct Value {
+  std::string path;
+  uint64 data[4];
+};
+
+template <class M>
+double MeasureLookup(const M &map, const std::vector<ResourceHash> &queries) {
+  uint64 checksum = 0;
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  for (auto &q : queries) {
+    checksum += map.find(q)->second.data[0];
+  }
+
+  auto dur = std::chrono::high_resolution_clock::now() - startTime;
+
+  if (checksum == 0) {
+    printf("Invalid checksum\n");
+  }
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() /
+         double(queries.size());
+}
+
+int main() {
+  constexpr size_t NUM_QUERIES = 2'000'000;
+  std::mt19937_64 rng(0x5eed);
+
+  for (size_t numItems : {10'000, 100'000, 1'000'000}) {
+    std::vector<ResourceHash> keys(numItems);
+    std::map<ResourceHash, Value> treeMap;
+    FlatHashMap<ResourceHash, Value> flatMap;
+
+    for (auto &k : keys) {
+      k = ResourceHash(uint64(rng()));
+      Value v{.path = "resource", .data = {k.hash | 1}};
+      treeMap.emplace(k, v);
+      flatMap.emplace(k, v);
+    }
+
+    std::vector<ResourceHash> queries(NUM_QUERIES);
+    std::generate(queries.begin(), queries.end(),
+                  [&] { return keys[rng() % numItems]; });
+
+    const double treeTime = MeasureLookup(treeMap, queries);
+    const double flatTime = MeasureLookup(flatMap, queries);
+
+    printf("[%7zu] std::map: %6.1f ns, FlatHashMap: %6.1f ns, %.2fx\n",
+           numItems, treeTime, flatTime, treeTime / flatTime);
+  }
+
+  return 0;
+}
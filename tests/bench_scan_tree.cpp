@@ -0,0 +1,122 @@
+#include "utils/scan_tree.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Former single threaded walk of WatchTree
+static void ScanSerial(const std::string &path, size_t &numFiles) {
+  DIR *cDir = opendir(path.c_str());
+
+  if (!cDir) {
+    return;
+  }
+
+  dirent *cFile = nullptr;
+
+  while ((cFile = readdir(cDir)) != nullptr) {
+    if (!strcmp(cFile->d_name, ".") || !strcmp(cFile->d_name, "..")) {
+      continue;
+    }
+
+    std::string absPath(path + '/' + cFile->d_name);
+
+    if (cFile->d_type == DT_DIR) {
+      ScanSerial(absPath, numFiles);
+    } else {
+      numFiles++;
+    }
+  }
+
+  closedir(cDir);
+}
+
+// 8 * 8 * 8 folders with filesPerFolder files each
+static size_t MakeTree(const std::string &root, size_t filesPerFolder) {
+  size_t numFiles = 0;
+  mkdir(root.c_str(), 0755);
+
+  for (int a = 0; a < 8; a++) {
+    std::string pa = root + "/a" + std::to_string(a);
+    mkdir(pa.c_str(), 0755);
+
+    for (int b = 0; b < 8; b++) {
+      std::string pb = pa + "/b" + std::to_string(b);
+      mkdir(pb.c_str(), 0755);
+
+      for (int c = 0; c < 8; c++) {
+        std::string pc = pb + "/c" + std::to_string(c);
+        mkdir(pc.c_str(), 0755);
+
+        for (size_t f = 0; f < filesPerFolder; f++) {
+          std::string file = pc + "/file" + std::to_string(f) + ".gltex";
+          close(open(file.c_str(), O_CREAT | O_WRONLY, 0644));
+          numFiles++;
+        }
+      }
+    }
+  }
+
+  return numFiles;
+}
+
+int main(int argc, char **argv) {
+  const size_t filesPerFolder = argc > 1 ? atoi(argv[1]) : 400;
+  char root[] = "/tmp/bench_scan_XXXXXX";
+
+  if (!mkdtemp(root)) {
+    printf("Failed to create temporary folder\n");
+    return 1;
+  }
+
+  const size_t numFiles = MakeTree(root, filesPerFolder);
+  printf("Tree with %zu files\n", numFiles);
+
+  for (int i = 0; i < 3; i++) {
+    size_t serialFiles = 0;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    ScanSerial(root, serialFiles);
+    auto serialTime = std::chrono::high_resolution_clock::now() - startTime;
+
+    std::atomic_size_t parallelFiles = 0;
+    startTime = std::chrono::high_resolution_clock::now();
+    prime::utils::ScanTree(
+        root, [](const std::string &, size_t) {},
+        [&](const std::string &, size_t) { parallelFiles++; });
+    auto parallelTime = std::chrono::high_resolution_clock::now() - startTime;
+
+    printf("readdir: %zu files %.2fms, ScanTree: %zu files %.2fms\n",
+           serialFiles,
+           std::chrono::duration<double, std::milli>(serialTime).count(),
+           parallelFiles.load(),
+           std::chrono::duration<double, std::milli>(parallelTime).count());
+  }
+
+  // Folders modified within last 2 seconds are not trusted by index
+  sleep(3);
+  const std::string indexPath = std::string(root) + "/.prime";
+  mkdir(indexPath.c_str(), 0755);
+
+  for (const char *pass : {"cold", "warm"}) {
+    std::atomic_size_t indexedFiles = 0;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    prime::utils::ScanTree(
+        root, indexPath + "/tree_index", [](const std::string &, size_t) {},
+        [&](const std::string &, size_t) { indexedFiles++; });
+    auto indexedTime = std::chrono::high_resolution_clock::now() - startTime;
+
+    printf("ScanTree with %s index: %zu files %.2fms\n", pass,
+           indexedFiles.load(),
+           std::chrono::duration<double, std::milli>(indexedTime).count());
+  }
+
+  std::string cmd("rm -rf ");
+  cmd.append(root);
+  return system(cmd.c_str());
+}
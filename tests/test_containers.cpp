@@ -0,0 +1,329 @@
+#include "common/flat_hash_map.hpp"
+#include "common/perfect_hash_map.hpp"
+#include "spike/master_printer.hpp"
+#include "spike/util/unit_testing.hpp"
+#include <map>
+#include <memory_resource>
+#include <random>
+
+namespace pc = prime::common;
+
+namespace prime::common {
+struct EarlyClass;
+}
+
+CLASS_EXT(prime::common::EarlyClass);
+REGISTER_CLASS(prime::common::EarlyClass);
+
+// murmur3 fmix64, same as FlatHashMap::Fingerprint and PerfectHashMap::Mix
+static uint64 Mix(uint64 h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static uint32 Fingerprint(uint32 key) { return uint32(Mix(key)); }
+
+static uint64 InverseOdd(uint64 c) {
+  uint64 inv = c;
+
+  // Newton iteration, each step doubles number of correct bits
+  for (int i = 0; i < 6; i++) {
+    inv *= 2 - c * inv;
+  }
+
+  return inv;
+}
+
+static uint64 Unmix(uint64 h) {
+  h ^= h >> 33;
+  h *= InverseOdd(0xc4ceb9fe1a85ec53ULL);
+  h ^= h >> 33;
+  h *= InverseOdd(0xff51afd7ed558ccdULL);
+  h ^= h >> 33;
+  return h;
+}
+
+static std::vector<uint32> KeysWithHome(size_t home, size_t mask,
+                                        size_t count) {
+  std::vector<uint32> retVal;
+
+  for (uint32 k = 1; retVal.size() < count; k++) {
+    if ((Fingerprint(k) & mask) == home) {
+      retVal.push_back(k);
+    }
+  }
+
+  return retVal;
+}
+
+static int TestFlatEraseWraparound() {
+  pc::FlatHashMap<uint32, uint32> map;
+  map.reserve(5);
+  const size_t mask = 7;
+
+  // Cluster starts at last slot and continues from slot 0
+  std::vector<uint32> lastHome = KeysWithHome(mask, mask, 3);
+  std::vector<uint32> firstHome = KeysWithHome(0, mask, 2);
+
+  for (uint32 k : lastHome) {
+    map.emplace(k, k * 10);
+  }
+
+  for (uint32 k : firstHome) {
+    map.emplace(k, k * 10);
+  }
+
+  TEST_EQUAL(map.size(), 5);
+
+  // Head of cluster, everything must shift back over the wrap
+  TEST_EQUAL(map.erase(lastHome[0]), 1);
+  TEST_CHECK(!map.contains(lastHome[0]));
+
+  for (uint32 k : {lastHome[1], lastHome[2], firstHome[0], firstHome[1]}) {
+    TEST_CHECK(map.contains(k));
+    TEST_EQUAL(map.at(k), k * 10);
+  }
+
+  // Slot 0 item is at home, must not move before it
+  TEST_EQUAL(map.erase(lastHome[1]), 1);
+  TEST_EQUAL(map.erase(firstHome[0]), 1);
+
+  for (uint32 k : {lastHome[2], firstHome[1]}) {
+    TEST_CHECK(map.contains(k));
+    TEST_EQUAL(map.at(k), k * 10);
+  }
+
+  TEST_EQUAL(map.size(), 2);
+  return 0;
+}
+
+static int TestFlatReferencesSurviveRehash() {
+  pc::FlatHashMap<uint32, uint32> map;
+  map.emplace(1, 100);
+  map.emplace(2, 200);
+  auto iter = map.find(1);
+  uint32 *value = &map.at(2);
+
+  // Many rehashes, values are not moved
+  for (uint32 k = 3; k < 5000; k++) {
+    map.emplace(k, k * 100);
+  }
+
+  TEST_EQUAL(iter->first, 1);
+  TEST_EQUAL(iter->second, 100);
+  TEST_CHECK(value == &map.at(2));
+  TEST_EQUAL(*value, 200);
+
+  // Erased values are recycled, survivors stay in place
+  for (uint32 k = 3; k < 5000; k += 2) {
+    map.erase(k);
+  }
+
+  for (uint32 k = 5000; k < 6000; k++) {
+    map.emplace(k, k * 100);
+  }
+
+  TEST_CHECK(value == &map.at(2));
+  size_t numItems = 0;
+
+  for (auto &[k, v] : map) {
+    TEST_EQUAL(v, k * 100);
+    numItems++;
+  }
+
+  TEST_EQUAL(numItems, map.size());
+  return 0;
+}
+
+static int TestFlatRandom() {
+  pc::FlatHashMap<uint32, uint32> map;
+  std::map<uint32, uint32> reference;
+  std::mt19937 rng(0x55);
+
+  // Small key range keeps table dense, clusters wrap often
+  for (size_t i = 0; i < 200000; i++) {
+    const uint32 key = rng() % 64;
+
+    if (rng() % 3 == 0) {
+      TEST_EQUAL(map.erase(key), reference.erase(key));
+    } else {
+      const uint32 value = rng();
+      map.insert_or_assign(key, value);
+      reference[key] = value;
+    }
+
+    if (i % 64 == 0) {
+      TEST_EQUAL(map.size(), reference.size());
+
+      for (uint32 k = 0; k < 64; k++) {
+        auto found = reference.find(k);
+        TEST_EQUAL(map.contains(k), found != reference.end());
+
+        if (found != reference.end()) {
+          TEST_EQUAL(map.at(k), found->second);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+struct CountingResource : std::pmr::memory_resource {
+  size_t numAllocations = 0;
+  size_t numBytes = 0;
+
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    numAllocations++;
+    numBytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+    numBytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+  }
+
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+static int TestFlatAllocator() {
+  CountingResource resource;
+
+  {
+    using Alloc =
+        std::pmr::polymorphic_allocator<std::pair<const uint32, uint32>>;
+    pc::FlatHashMap<uint32, uint32, Alloc> map(&resource);
+
+    for (uint32 k = 0; k < 1000; k++) {
+      map.emplace(k, k * 3);
+    }
+
+    for (uint32 k = 0; k < 1000; k += 2) {
+      map.erase(k);
+    }
+
+    TEST_EQUAL(map.size(), 500);
+
+    for (uint32 k = 1; k < 1000; k += 2) {
+      TEST_EQUAL(map.at(k), k * 3);
+    }
+
+    // Slots, values and free list all come from resource
+    TEST_CHECK(resource.numAllocations >= 3);
+    TEST_CHECK(resource.numBytes > 0);
+  }
+
+  TEST_EQUAL(resource.numBytes, 0);
+  return 0;
+}
+
+static int TestPerfectRetry() {
+  std::vector<std::pair<uint32, uint32>> items;
+
+  for (uint32 i = 0; i < 64; i++) {
+    items.emplace_back(i * 7919, i);
+  }
+
+  // Single displacement per bucket cannot place 64 keys into 256 slots
+  // Build must fail and retry with more slots until it fits
+  pc::PerfectHashMap<uint32, uint32, 1> map(items);
+  TEST_CHECK(map.capacity() > std::bit_ceil(items.size() * 2 + 1));
+  TEST_EQUAL(map.size(), items.size());
+
+  for (auto &[k, v] : items) {
+    const uint32 *found = map.find(k);
+    TEST_CHECK(found);
+    TEST_EQUAL(*found, v);
+  }
+
+  for (uint32 k = 1; k < 7919; k++) {
+    TEST_CHECK(!map.find(k));
+  }
+
+  return 0;
+}
+
+static int TestPerfectSharedUpperHash() {
+  // Mixed hashes differ only in low bits, upper half is same for all
+  std::vector<std::pair<uint64, uint32>> items;
+  const uint64 base = 0x123456789abc0000ULL;
+
+  for (uint32 i = 0; i < 32; i++) {
+    const uint64 key = Unmix(base | i);
+    TEST_EQUAL(Mix(key), base | i);
+    items.emplace_back(key, i);
+  }
+
+  pc::PerfectHashMap<uint64, uint32> map(items);
+
+  for (auto &[k, v] : items) {
+    const uint32 *found = map.find(k);
+    TEST_CHECK(found);
+    TEST_EQUAL(*found, v);
+  }
+
+  return 0;
+}
+
+static int TestRegistryLateClass() {
+  const pc::ExtString earlyExtStr = pc::GetClassExtension<pc::EarlyClass>();
+  const std::string_view earlyExt = earlyExtStr;
+  const uint32 earlyHash = pc::GetClassHash<pc::EarlyClass>();
+
+  // Builds tables from classes registered during static initialization
+  TEST_EQUAL(pc::GetClassFromExtension(earlyExt).retVal, earlyHash);
+
+  const pc::ExtString lateExt(std::string_view("latecls"));
+  const uint32 lateHash = 0x1a7ec1a5;
+  TEST_CHECK(pc::GetClassFromExtension("latecls").status);
+  pc::detail::RegisterClass(lateExt, lateHash);
+
+  auto found = pc::GetClassFromExtension("latecls");
+  TEST_CHECK(!found.status);
+  TEST_EQUAL(found.retVal, lateHash);
+  TEST_CHECK(pc::GetExtentionFromHash(lateHash) == "latecls");
+
+  // Classes from tables are not replaced by late registration
+  pc::detail::RegisterClass(earlyExtStr, 1);
+  TEST_EQUAL(pc::GetClassFromExtension(earlyExt).retVal, earlyHash);
+  TEST_CHECK(pc::GetExtentionFromHash(earlyHash) == earlyExt);
+
+  return 0;
+}
+
+int main() {
+  es::print::AddPrinterFunction(es::Print);
+
+  if (int failed = TestFlatEraseWraparound()) {
+    return failed;
+  }
+
+  if (int failed = TestFlatReferencesSurviveRehash()) {
+    return failed;
+  }
+
+  if (int failed = TestFlatRandom()) {
+    return failed;
+  }
+
+  if (int failed = TestFlatAllocator()) {
+    return failed;
+  }
+
+  if (int failed = TestPerfectRetry()) {
+    return failed;
+  }
+
+  if (int failed = TestPerfectSharedUpperHash()) {
+    return failed;
+  }
+
+  return TestRegistryLateClass();
+}
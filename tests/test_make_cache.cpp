@@ -0,0 +1,308 @@
+#include "common/cache.hpp"
+#include "common/resource.hpp"
+#include "spike/app_context.hpp"
+#include "spike/crypto/crc32.hpp"
+#include "spike/io/binreader.hpp"
+#include "spike/io/binwritter.hpp"
+#include "spike/master_printer.hpp"
+#include "spike/reflect/reflector.hpp"
+#include "spike/util/unit_testing.hpp"
+#include "utils/debug.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+#include <vector>
+
+namespace pc = prime::common;
+namespace pu = prime::utils;
+
+namespace prime::common {
+struct CacheTestData;
+}
+
+CLASS_EXT(prime::common::CacheTestData);
+REGISTER_CLASS(prime::common::CacheTestData);
+
+// Same as in make_cache.cpp
+struct MakeCache : ReflectorBase<MakeCache> {
+  bool incremental = false;
+  bool stripDebug = false;
+};
+
+extern MakeCache settings;
+AppPackContext *AppNewArchive(const std::string &folder);
+
+static const std::string ARCHIVE = "test_make_cache";
+static constexpr size_t BLOCK_SIZE = pc::Cache::BLOCK_SIZE;
+
+using Files = std::map<std::string, std::string>;
+
+static std::string IndexPath(const std::string &archive = ARCHIVE) {
+  std::string retVal = archive + ".";
+  retVal.append(pc::GetClassExtension<pc::Cache>());
+  return retVal;
+}
+
+static bool FileExists(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+static void MakeArchive(const std::string &archive, const Files &files,
+                        bool incremental) {
+  settings.incremental = incremental;
+  std::unique_ptr<AppPackContext> ctx(AppNewArchive(archive));
+  std::string ext(pc::GetClassExtension<pc::CacheTestData>());
+
+  for (auto &[name, data] : files) {
+    std::stringstream str(data);
+    ctx->SendFile(name + "." + ext, str);
+  }
+
+  ctx->Finish();
+}
+
+static std::vector<uint32> BlockCrcs(const std::string &archive) {
+  BinReader rd(IndexPath(archive));
+  std::string index;
+  rd.ReadContainer(index, rd.GetSize());
+  const pc::Cache *cache = reinterpret_cast<const pc::Cache *>(index.data());
+  std::vector<uint32> retVal;
+
+  for (const pc::CacheBlock &b : cache->blocks) {
+    retVal.push_back(b.crc);
+  }
+
+  return retVal;
+}
+
+// Flips bits at patchAt, so crc32b of block becomes crc
+// Crc is affine over GF(2), 32 consecutive bits can reach any value
+static bool ForceCrc(std::string &block, uint32 crc, size_t patchAt) {
+  std::string diff(block.size(), 0);
+  const uint32 zeroCrc = crc32b(0, diff.data(), diff.size());
+  uint32 basis[32]{};
+  uint32 combos[32]{};
+
+  for (uint32 b = 0; b < 32; b++) {
+    diff[patchAt + b / 8] = char(1 << (b % 8));
+    uint32 column = crc32b(0, diff.data(), diff.size()) ^ zeroCrc;
+    uint32 combo = 1u << b;
+    diff[patchAt + b / 8] = 0;
+
+    for (int bit = 31; bit >= 0 && column; bit--) {
+      if (!(column >> bit & 1)) {
+        continue;
+      }
+
+      if (!basis[bit]) {
+        basis[bit] = column;
+        combos[bit] = combo;
+        break;
+      }
+
+      column ^= basis[bit];
+      combo ^= combos[bit];
+    }
+  }
+
+  uint32 target = crc32b(0, block.data(), block.size()) ^ crc;
+  uint32 flips = 0;
+
+  for (int bit = 31; bit >= 0; bit--) {
+    if (!(target >> bit & 1)) {
+      continue;
+    }
+
+    if (!basis[bit]) {
+      return false;
+    }
+
+    target ^= basis[bit];
+    flips ^= combos[bit];
+  }
+
+  for (uint32 b = 0; b < 32; b++) {
+    if (flips >> b & 1) {
+      block[patchAt + b / 8] ^= char(1 << (b % 8));
+    }
+  }
+
+  return true;
+}
+
+int main() {
+  es::print::AddPrinterFunction(es::Print);
+  std::mt19937 rng(0x1234);
+  Files files;
+  static const char *WORDS[]{"vertex", "index", "texture", "sampler",
+                             "shader", "uniform", "model", "material"};
+
+  // Small files train dictionary
+  for (size_t i = 0; i < 16; i++) {
+    std::string &data = files["small" + std::to_string(i)];
+
+    while (data.size() < 0x1000) {
+      data.append(WORDS[rng() % 8]);
+      data.push_back(' ');
+    }
+  }
+
+  std::string &big = files["big"];
+  big.resize(BLOCK_SIZE * 3 + 1234);
+
+  for (char &c : big) {
+    c = rng() % 16;
+  }
+
+  MakeArchive(ARCHIVE, files, false);
+
+  // Locate block fully covered by big file
+  size_t bigBegin = 0;
+  {
+    BinReader rd(IndexPath());
+    std::string index;
+    rd.ReadContainer(index, rd.GetSize());
+    const pc::Cache *cache = reinterpret_cast<const pc::Cache *>(index.data());
+    const pc::ResourceHash bigHash = pc::MakeHash<pc::CacheTestData>("big");
+    bool found = false;
+
+    for (const pc::CacheFile &f : cache->files) {
+      if (f.info.hash == bigHash.hash) {
+        bigBegin = f.blockOffset * BLOCK_SIZE + f.microOffset;
+        found = true;
+      }
+    }
+
+    TEST_CHECK(found);
+  }
+
+  const size_t blockBegin =
+      (bigBegin + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE - bigBegin;
+  TEST_CHECK(blockBegin + BLOCK_SIZE <= big.size());
+
+  // Change one block without changing its raw crc, only contents comparison
+  // can tell it from previous one
+  std::string block = big.substr(blockBegin, BLOCK_SIZE);
+  const uint32 blockCrc = crc32b(0, block.data(), block.size());
+  block[1000] ^= 0x5A;
+  TEST_CHECK(ForceCrc(block, blockCrc, 2000));
+  TEST_EQUAL(crc32b(0, block.data(), block.size()), blockCrc);
+  TEST_CHECK(block != big.substr(blockBegin, BLOCK_SIZE));
+  big.replace(blockBegin, BLOCK_SIZE, block);
+  files["small3"].append("changed");
+
+  MakeArchive(ARCHIVE, files, true);
+  TEST_CHECK(!FileExists(IndexPath() + ".prev"));
+  TEST_CHECK(!FileExists(ARCHIVE + ".dat.prev"));
+
+  // Build killed after truncating outputs, previous files are still in place
+  std::rename(IndexPath().c_str(), (IndexPath() + ".prev").c_str());
+  std::rename((ARCHIVE + ".dat").c_str(), (ARCHIVE + ".dat.prev").c_str());
+  {
+    BinWritter partial(IndexPath());
+    partial.WriteContainer(std::string("partial"));
+  }
+
+  MakeArchive(ARCHIVE, files, true);
+  TEST_CHECK(!FileExists(IndexPath() + ".prev"));
+  TEST_CHECK(!FileExists(ARCHIVE + ".dat.prev"));
+
+  TEST_CHECK(!pc::AddCacheArchive(ARCHIVE).status);
+
+  for (auto &[name, data] : files) {
+    std::string buffer;
+    auto hash = pc::MakeHash<pc::CacheTestData>(name);
+    TEST_CHECK(!pc::ReadCacheResource(hash, buffer).status);
+    TEST_EQUAL(buffer.size(), data.size());
+    TEST_CHECK(buffer == data);
+  }
+
+  // File in middle of class grows, only blocks around it are new
+  const std::string growArchive = ARCHIVE + "_grow";
+  Files growFiles;
+
+  for (size_t i = 0; i < 24; i++) {
+    std::string &data = growFiles["grow" + std::to_string(i)];
+    data.resize(0x18000);
+
+    for (char &c : data) {
+      c = rng() % 16;
+    }
+  }
+
+  MakeArchive(growArchive, growFiles, false);
+  const std::vector<uint32> prevCrcs = BlockCrcs(growArchive);
+  std::vector<std::pair<pc::ResourceHash, std::string>> growOrder;
+
+  for (auto &[name, data] : growFiles) {
+    growOrder.emplace_back(pc::MakeHash<pc::CacheTestData>(name), name);
+  }
+
+  std::sort(growOrder.begin(), growOrder.end());
+  growFiles[growOrder[4].second].append(0x1000, 'g');
+  MakeArchive(growArchive, growFiles, true);
+  const std::vector<uint32> growCrcs = BlockCrcs(growArchive);
+  const std::set<uint32> prevCrcSet(prevCrcs.begin(), prevCrcs.end());
+  const size_t numNewBlocks =
+      std::count_if(growCrcs.begin(), growCrcs.end(),
+                    [&](uint32 crc) { return !prevCrcSet.contains(crc); });
+  TEST_CHECK(growCrcs.size() >= prevCrcs.size());
+  // Block with grown file and block padded before next file
+  TEST_CHECK(numNewBlocks <= 3);
+
+  TEST_CHECK(!pc::AddCacheArchive(growArchive).status);
+
+  for (auto &[name, data] : growFiles) {
+    std::string buffer;
+    auto hash = pc::MakeHash<pc::CacheTestData>(name);
+    TEST_CHECK(!pc::ReadCacheResource(hash, buffer).status);
+    TEST_CHECK(buffer == data);
+  }
+
+  // Debug is stripped into sidecar and joined back on read
+  const std::string stripArchive = ARCHIVE + "_strip";
+  const std::string patchArchive = ARCHIVE + "_patch";
+  const std::string payload(0x300, 'p');
+  std::string withDebug = payload + "debug data..";
+  const pu::ResourceDebugFooter footer{.dataSize = uint32(payload.size())};
+  withDebug.append(reinterpret_cast<const char *>(&footer), sizeof(footer));
+
+  settings.stripDebug = true;
+  MakeArchive(stripArchive, {{"withdebug", withDebug}}, false);
+  settings.stripDebug = false;
+  TEST_CHECK(!pc::AddCacheArchive(stripArchive).status);
+  TEST_CHECK(!pc::AddCacheDebugArchive(stripArchive).status);
+  const auto debugHash = pc::MakeHash<pc::CacheTestData>("withdebug");
+  {
+    std::string buffer;
+    TEST_CHECK(!pc::ReadCacheResource(debugHash, buffer).status);
+    TEST_CHECK(buffer == withDebug);
+  }
+
+  // Patch has same payload size, debug of original must not be joined
+  std::string patched = payload;
+  patched[5] = 'x';
+  MakeArchive(patchArchive, {{"withdebug", patched}}, false);
+  TEST_CHECK(!pc::AddCacheArchive(patchArchive).status);
+  {
+    std::string buffer;
+    TEST_CHECK(!pc::ReadCacheResource(debugHash, buffer).status);
+    TEST_CHECK(buffer == patched);
+  }
+
+  for (const std::string &archive :
+       {ARCHIVE, growArchive, stripArchive, stripArchive + ".debug",
+        patchArchive}) {
+    std::remove(IndexPath(archive).c_str());
+    std::remove((archive + ".dat").c_str());
+    std::remove((archive + ".refs").c_str());
+  }
+
+  return 0;
+}
@@ -1,6 +1,8 @@
 #include "graphics/model_single.hpp"
 #include "spike/util/unit_testing.hpp"
 #include "utils/debug.hpp"
+#include <random>
+#include <stdexcept>
 
 namespace pu = prime::utils;
 namespace pc = prime::common;
@@ -21,8 +23,627 @@ struct SampleClass {
 
 HASH_CLASS(SampleClass);
 
+struct MoveItem {
+  pc::String name;
+  pc::LocalPointer<uint32> value;
+  uint32 number;
+};
+
+HASH_CLASS(MoveItem);
+
+// Build writes maxAlign into ResourceBase in front of main block
+struct MoveRoot {
+  pc::ResourceBase base;
+  pc::LocalArray32<MoveItem> items;
+  pc::LocalArray32<uint32> values;
+  pc::LocalPointer<MoveItem> first;
+};
+
+HASH_CLASS(MoveRoot);
+
+static std::string MoveItemName(uint32 index) {
+  return "moved item name " + std::to_string(index);
+}
+
+static int CheckMoveRoot(MoveRoot &root, uint32 numItems) {
+  TEST_EQUAL(root.items.numItems, numItems);
+  TEST_EQUAL(root.values.numItems, numItems);
+  TEST_CHECK(root.first.Get() == root.items.begin());
+
+  for (uint32 i = 0; i < numItems; i++) {
+    MoveItem &item = root.items[i];
+    TEST_EQUAL(item.number, i);
+    TEST_CHECK(std::string_view(item.name) == MoveItemName(i));
+    TEST_CHECK(item.value.Get() == &root.values[i]);
+    TEST_EQUAL(*item.value, i * 10);
+  }
+
+  return 0;
+}
+
+static int TestReallocMove() {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<MoveRoot> root = pg.AddClass<MoveRoot>();
+  const uint32 numItems = 16;
+  uint32 itemsOffset = 0;
+  uint32 valuesOffset = 0;
+
+  // Names are allocated right after arrays, so arrays cannot grow in place
+  // Moved items carry outbound pointers, first and values point into them
+  for (uint32 i = 0; i < numItems; i++) {
+    pu::PlayGround::Pointer<MoveItem> item = pg.ArrayEmplace(root->items);
+    item->number = i;
+    pg.NewString(item->name, MoveItemName(i));
+    pg.ArrayEmplace(root->values, i * 10);
+    pg.Link(root->items[i].value, &root->values[i]);
+
+    if (i == 0) {
+      pg.Link(root->first, root->items.begin());
+      itemsOffset = reinterpret_cast<char *>(root->items.begin()) -
+                    pg.As<char>();
+      valuesOffset = reinterpret_cast<char *>(root->values.begin()) -
+                     pg.As<char>();
+    }
+  }
+
+  TEST_CHECK(reinterpret_cast<char *>(root->items.begin()) - pg.As<char>() !=
+             itemsOffset);
+  TEST_CHECK(reinterpret_cast<char *>(root->values.begin()) - pg.As<char>() !=
+             valuesOffset);
+
+  if (int failed = CheckMoveRoot(*root, numItems)) {
+    return failed;
+  }
+
+  std::string built = pg.Build();
+  return CheckMoveRoot(*reinterpret_cast<MoveRoot *>(built.data()), numItems);
+}
+
+struct GapRoot {
+  pc::ResourceBase base;
+  pc::LocalArray32<uint32> first;
+  pc::LocalArray32<uint32> second;
+  pc::LocalArray32<uint32> third;
+  pc::LocalArray32<uint32> merged;
+};
+
+HASH_CLASS(GapRoot);
+
+static int TestGapCoalescing() {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<GapRoot> root = pg.AddClass<GapRoot>();
+  auto Offset = [&](pc::LocalArray32<uint32> &array) {
+    return reinterpret_cast<char *>(array.begin()) - pg.As<char>();
+  };
+
+  // Three adjacent 4 byte blocks
+  pg.ArrayEmplace(root->first, 1u);
+  pg.ArrayEmplace(root->second, 2u);
+  pg.ArrayEmplace(root->third, 3u);
+  const auto firstOffset = Offset(root->first);
+  TEST_EQUAL(Offset(root->second), firstOffset + 4);
+  TEST_EQUAL(Offset(root->third), firstOffset + 8);
+
+  // Outer blocks move out and leave two separate gaps
+  pg.ArrayEmplace(root->first, 11u);
+  pg.ArrayEmplace(root->third, 33u);
+  TEST_CHECK(Offset(root->first) != firstOffset);
+  TEST_CHECK(Offset(root->third) != firstOffset + 8);
+
+  // Middle block is too large for gap after it, freed range joins both gaps
+  const uint32 second[]{2, 22, 222};
+  pg.ArraySet(root->second, second);
+  TEST_CHECK(Offset(root->second) != firstOffset + 4);
+
+  // Best fit, exactly fits into joined gap
+  const uint32 merged[]{4, 44, 444};
+  pg.ArraySet(root->merged, merged);
+  TEST_EQUAL(Offset(root->merged), firstOffset);
+
+  std::string built = pg.Build();
+  GapRoot *cls = reinterpret_cast<GapRoot *>(built.data());
+  TEST_EQUAL(cls->first.numItems, 2);
+  TEST_EQUAL(cls->first[1], 11);
+  TEST_EQUAL(cls->second.numItems, 3);
+  TEST_EQUAL(cls->second[2], 222);
+  TEST_EQUAL(cls->third.numItems, 2);
+  TEST_EQUAL(cls->third[1], 33);
+  TEST_EQUAL(cls->merged.numItems, 3);
+  TEST_EQUAL(cls->merged[2], 444);
+
+  return 0;
+}
+
+struct WideValue {
+  uint64 value;
+};
+
+HASH_CLASS(WideValue);
+
+struct GoldenNode {
+  pc::String name;
+  pc::LocalArray32<uint32> values;
+  pc::LocalArray32<WideValue> wide;
+};
+
+HASH_CLASS(GoldenNode);
+
+struct GoldenRoot {
+  pc::ResourceBase base;
+  pc::LocalArray32<GoldenNode> nodes;
+  pc::LocalArray32<pc::String> tags;
+};
+
+HASH_CLASS(GoldenRoot);
+
+// FNV-1a
+static uint64 HashOutput(std::string_view data) {
+  uint64 hash = 0xcbf29ce484222325ULL;
+
+  for (char c : data) {
+    hash ^= uint8(c);
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+// Random growth of arrays and strings, keeps at most maxBlocks blocks
+static std::string BuildGolden(pu::PlayGround &pg, uint32 seed,
+                               uint32 maxBlocks) {
+  std::mt19937 rng(seed);
+  pu::PlayGround::Pointer<GoldenRoot> root = pg.AddClass<GoldenRoot>();
+  uint32 numBlocks = 1;
+  // Node arrays that already have a block {values, wide}
+  std::vector<std::pair<bool, bool>> usedArrays;
+
+  for (uint32 i = 0; i < 200; i++) {
+    const uint32 op = rng() % 4;
+    const uint32 numNodes = root->nodes.numItems;
+
+    if (numNodes == 0 || op == 0) {
+      if (numBlocks + (numNodes == 0) > maxBlocks) {
+        continue;
+      }
+
+      numBlocks += numNodes == 0;
+      pg.ArrayEmplace(root->nodes);
+      usedArrays.emplace_back(false, false);
+      continue;
+    }
+
+    const uint32 index = rng() % numNodes;
+
+    if (op == 1) {
+      if (!usedArrays[index].first) {
+        if (numBlocks == maxBlocks) {
+          continue;
+        }
+
+        numBlocks++;
+        usedArrays[index].first = true;
+      }
+
+      pg.ArrayEmplace(root->nodes[index].values, uint32(rng()));
+    } else if (op == 2) {
+      if (!usedArrays[index].second) {
+        if (numBlocks == maxBlocks) {
+          continue;
+        }
+
+        numBlocks++;
+        usedArrays[index].second = true;
+      }
+
+      pg.ArrayEmplace(root->nodes[index].wide,
+                     WideValue{uint64(rng()) << 32 | rng()});
+    } else {
+      // Strings over 7 characters take their own block
+      const uint32 length = rng() % 24;
+      const uint32 newBlocks = (length > 7) + (root->tags.numItems == 0);
+
+      if (numBlocks + newBlocks > maxBlocks) {
+        continue;
+      }
+
+      numBlocks += newBlocks;
+      std::string tag(length, char('a' + rng() % 26));
+      pg.NewString(*pg.ArrayEmplace(root->tags), tag);
+    }
+  }
+
+  return pg.Build();
+}
+
+static void FillGoldenDebug(pu::ResourceDebugPlayground &debugPg) {
+  for (uint32 i = 0; i < 4; i++) {
+    const std::string path = "textures/item" + std::to_string(i);
+    debugPg.AddRef(path, 0x100 + i % 3);
+    debugPg.AddRef(path, 0x200);
+    debugPg.AddString("string " + std::to_string(i % 3));
+  }
+}
+
+// Recorded from implementation before indexed pointers and gap allocator
+// Older one ordered equal gaps and equal alignment blocks by std::sort,
+// which is stable only up to 16 items, so results are compared only for
+// resources up to 17 blocks, where its output was well defined
+static int TestBaselineOutput() {
+  static const std::pair<size_t, uint64> GOLDEN[]{
+      {2201, 0x4acfcb959221b827},
+      {2021, 0x5ee49f260397c1b5},
+      {1930, 0xea4f29e9f27f3852},
+      {2619, 0x04caf5dd50a31440},
+      {1824, 0xeade97d877e3cb73},
+      {2245, 0xcc4396b27d1ea798},
+      {2017, 0x37026e07715a62fa},
+      {2107, 0xa484f5e3f601b064},
+  };
+
+  for (uint32 seed = 0; auto [size, hash] : GOLDEN) {
+    pu::PlayGround pg;
+    const std::string built = BuildGolden(pg, seed++, 17);
+    TEST_EQUAL(built.size(), size);
+    TEST_EQUAL(HashOutput(built), hash);
+  }
+
+  pu::ResourceDebugPlayground debugPg;
+  FillGoldenDebug(debugPg);
+  const std::string debug = debugPg.PlayGround::Build();
+  TEST_EQUAL(debug.size(), 264);
+  TEST_EQUAL(HashOutput(debug), 0xabb7b07f7ec56aa4);
+
+  return 0;
+}
+
+static int TestReset() {
+  const char *memory = nullptr;
+
+  {
+    pu::PlayGround pg;
+
+    for (uint32 seed = 0; seed < 8; seed++) {
+      pg.Reset();
+      pu::PlayGround fresh;
+      TEST_CHECK(BuildGolden(pg, seed, 17) == BuildGolden(fresh, seed, 17));
+    }
+
+    // Same sequence again fits into memory kept by Reset
+    pg.Reset();
+    memory = pg.As<char>();
+    TEST_CHECK(!BuildGolden(pg, 7, 17).empty());
+    TEST_CHECK(pg.As<char>() == memory);
+  }
+
+  // Memory of destroyed playground is taken by next one on this thread
+  pu::PlayGround pg;
+  TEST_CHECK(pg.As<char>() == memory);
+
+  return 0;
+}
+
+static int TestDebugReset() {
+  pu::PlayGround base;
+  pu::ResourceDebugPlayground fresh;
+  FillGoldenDebug(fresh);
+  const std::string expected =
+      fresh.Build<prime::graphics::ModelSingle>(base);
+
+  pu::ResourceDebugPlayground debugPg;
+  debugPg.AddRef("textures/item0", 0x300);
+  debugPg.AddString("string 0");
+  debugPg.AddString("dropped by reset");
+  [[maybe_unused]] const std::string previous =
+      debugPg.Build<prime::graphics::ModelSingle>(base);
+  debugPg.Reset();
+
+  // Main is valid, arrays and dedup indexes are empty
+  TEST_EQUAL(debugPg.main->dependencies.numItems, 0);
+  TEST_EQUAL(debugPg.main->strings.numItems, 0);
+  TEST_EQUAL(debugPg.main->classes.numItems, 0);
+  FillGoldenDebug(debugPg);
+  TEST_EQUAL(debugPg.main->dependencies.numItems, 4);
+  TEST_EQUAL(debugPg.main->strings.numItems, 3);
+  TEST_CHECK(debugPg.Build<prime::graphics::ModelSingle>(base) == expected);
+
+  return 0;
+}
+
+struct LinkedClass {
+  pc::LocalArray32<uint32> members;
+  uint32 id;
+};
+
+HASH_CLASS(LinkedClass);
+
+struct LinkedType {
+  pc::LocalPointer<LinkedClass> definition;
+  uint32 classId;
+};
+
+HASH_CLASS(LinkedType);
+
+struct LinkRoot {
+  pc::ResourceBase base;
+  pc::LocalArray32<LinkedClass> classes;
+  pc::LocalArray32<LinkedType> types;
+};
+
+HASH_CLASS(LinkRoot);
+
+static int CheckLinkRoot(LinkRoot &root, uint32 numClasses) {
+  TEST_EQUAL(root.classes.numItems, numClasses);
+  TEST_EQUAL(root.types.numItems, numClasses);
+
+  for (uint32 i = 0; i < numClasses; i++) {
+    LinkedClass &cls = root.classes[i];
+    TEST_EQUAL(cls.id, i);
+    TEST_EQUAL(cls.members.numItems, i % 3 + 1);
+    TEST_EQUAL(cls.members[i % 3], i);
+
+    LinkedType &type = root.types[i];
+    TEST_CHECK(type.definition.Get() == &root.classes[type.classId]);
+    TEST_EQUAL(type.definition->id, type.classId);
+  }
+
+  return 0;
+}
+
+// Same shape as ResourceDebugDataType::definition pointing into classes
+static int TestLinkIntoMovedArray() {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<LinkRoot> root = pg.AddClass<LinkRoot>();
+  const uint32 numClasses = 24;
+
+  for (uint32 i = 0; i < numClasses; i++) {
+    pu::PlayGround::Pointer<LinkedClass> cls = pg.ArrayEmplace(root->classes);
+    cls->id = i;
+
+    for (uint32 m = 0; m <= i % 3; m++) {
+      pg.ArrayEmplace(cls->members, m == i % 3 ? i : 0);
+    }
+
+    // Links into middle of classes, classes keep moving afterwards
+    pu::PlayGround::Pointer<LinkedType> type = pg.ArrayEmplace(root->types);
+    type->classId = i / 2;
+    pg.Link(type->definition, &root->classes[i / 2]);
+  }
+
+  if (int failed = CheckLinkRoot(*root, numClasses)) {
+    return failed;
+  }
+
+  std::string built = pg.Build();
+  return CheckLinkRoot(*reinterpret_cast<LinkRoot *>(built.data()),
+                       numClasses);
+}
+
+static int TestLinkOutside() {
+  pu::PlayGround pg;
+  pu::PlayGround::Pointer<MoveRoot> root = pg.AddClass<MoveRoot>();
+  pg.ArrayEmplace(root->items);
+  MoveItem outside{};
+  pg.Link(root->first, &outside);
+
+  bool thrown = false;
+
+  try {
+    pg.Build();
+  } catch (const std::logic_error &) {
+    thrown = true;
+  }
+
+  TEST_CHECK(thrown);
+  return 0;
+}
+
+struct RandomNode {
+  pc::String name;
+  pc::LocalArray32<uint32> values;
+  pc::LocalArray32<pc::String> tags;
+  pc::LocalArray32<WideValue> wide;
+  pc::LocalPointer<uint32> pick;
+};
+
+HASH_CLASS(RandomNode);
+
+struct RandomRoot {
+  pc::ResourceBase base;
+  pc::LocalArray32<RandomNode> nodes;
+  pc::LocalArray32<uint8> bytes;
+};
+
+HASH_CLASS(RandomRoot);
+
+struct ModelNode {
+  std::string name;
+  std::vector<uint32> values;
+  std::vector<std::string> tags;
+  std::vector<uint64> wide;
+  // Index of node and its value, pick points to
+  int32 pickNode = -1;
+  uint32 pickValue = 0;
+};
+
+struct Model {
+  std::vector<ModelNode> nodes;
+  std::vector<uint8> bytes;
+};
+
+static int CheckModel(RandomRoot &root, const Model &model) {
+  TEST_EQUAL(root.nodes.numItems, model.nodes.size());
+  TEST_EQUAL(root.bytes.numItems, model.bytes.size());
+
+  for (size_t i = 0; i < model.bytes.size(); i++) {
+    TEST_EQUAL(root.bytes[i], model.bytes[i]);
+  }
+
+  for (size_t i = 0; i < model.nodes.size(); i++) {
+    RandomNode &node = root.nodes[i];
+    const ModelNode &mNode = model.nodes[i];
+    TEST_CHECK(std::string_view(node.name) == mNode.name);
+    TEST_EQUAL(node.values.numItems, mNode.values.size());
+    TEST_EQUAL(node.tags.numItems, mNode.tags.size());
+    TEST_EQUAL(node.wide.numItems, mNode.wide.size());
+
+    for (size_t j = 0; j < mNode.values.size(); j++) {
+      TEST_EQUAL(node.values[j], mNode.values[j]);
+    }
+
+    for (size_t j = 0; j < mNode.tags.size(); j++) {
+      TEST_CHECK(std::string_view(node.tags[j]) == mNode.tags[j]);
+    }
+
+    for (size_t j = 0; j < mNode.wide.size(); j++) {
+      TEST_EQUAL(node.wide[j].value, mNode.wide[j]);
+    }
+
+    if (mNode.pickNode >= 0) {
+      TEST_CHECK(node.pick.Get() ==
+                 &root.nodes[mNode.pickNode].values[mNode.pickValue]);
+    }
+  }
+
+  return 0;
+}
+
+static std::string RandomString(std::mt19937 &rng) {
+  // Mix of tiny strings and strings with own block
+  const size_t length = rng() % 3 == 0 ? rng() % 7 : 8 + rng() % 40;
+  std::string retVal;
+
+  for (size_t i = 0; i < length; i++) {
+    retVal.push_back('a' + rng() % 26);
+  }
+
+  return retVal;
+}
+
+// Random build sequences checked against plain containers
+static int TestRandomModel() {
+  for (uint32 seed = 0; seed < 64; seed++) {
+    std::mt19937 rng(seed);
+    pu::PlayGround pg;
+    pu::PlayGround::Pointer<RandomRoot> root = pg.AddClass<RandomRoot>();
+    Model model;
+
+    for (uint32 i = 0; i < 300; i++) {
+      const uint32 op = rng() % 7;
+
+      if (model.nodes.empty() || op == 0) {
+        pu::PlayGround::Pointer<RandomNode> node =
+            pg.ArrayEmplace(root->nodes);
+        ModelNode &mNode = model.nodes.emplace_back();
+
+        if (rng() % 2) {
+          mNode.name = RandomString(rng);
+          pg.NewString(node->name, mNode.name);
+        }
+
+        continue;
+      }
+
+      const uint32 index = rng() % model.nodes.size();
+      ModelNode &mNode = model.nodes[index];
+
+      switch (op) {
+      case 1: {
+        const uint32 value = rng();
+        pg.ArrayEmplace(root->nodes[index].values, value);
+        mNode.values.push_back(value);
+        break;
+      }
+      case 2: {
+        const std::string tag = RandomString(rng);
+        pg.NewString(*pg.ArrayEmplace(root->nodes[index].tags), tag);
+        mNode.tags.push_back(tag);
+        break;
+      }
+      case 3: {
+        const std::string tag = RandomString(rng);
+        pg.NewCString(*pg.ArrayEmplace(root->nodes[index].tags), tag);
+        mNode.tags.push_back(tag);
+        break;
+      }
+      case 4: {
+        const uint64 value = uint64(rng()) << 32 | rng();
+        pg.ArrayEmplace(root->nodes[index].wide, WideValue{value});
+        mNode.wide.push_back(value);
+        break;
+      }
+      case 5: {
+        const uint8 value = rng();
+        pg.ArrayEmplace(root->bytes, value);
+        model.bytes.push_back(value);
+        break;
+      }
+      default: {
+        const uint32 target = rng() % model.nodes.size();
+        const size_t numValues = model.nodes[target].values.size();
+
+        if (numValues == 0) {
+          break;
+        }
+
+        const uint32 value = rng() % numValues;
+        pg.Link(root->nodes[index].pick, &root->nodes[target].values[value]);
+        mNode.pickNode = target;
+        mNode.pickValue = value;
+        break;
+      }
+      }
+    }
+
+    if (int failed = CheckModel(*root, model)) {
+      return failed;
+    }
+
+    std::string built = pg.Build();
+
+    if (int failed =
+            CheckModel(*reinterpret_cast<RandomRoot *>(built.data()), model)) {
+      return failed;
+    }
+  }
+
+  return 0;
+}
+
 int main() {
   es::print::AddPrinterFunction(es::Print);
+
+  if (int failed = TestReallocMove()) {
+    return failed;
+  }
+
+  if (int failed = TestGapCoalescing()) {
+    return failed;
+  }
+
+  if (int failed = TestBaselineOutput()) {
+    return failed;
+  }
+
+  if (int failed = TestReset()) {
+    return failed;
+  }
+
+  if (int failed = TestDebugReset()) {
+    return failed;
+  }
+
+  if (int failed = TestLinkIntoMovedArray()) {
+    return failed;
+  }
+
+  if (int failed = TestLinkOutside()) {
+    return failed;
+  }
+
+  if (int failed = TestRandomModel()) {
+    return failed;
+  }
+
   pu::PlayGround pg;
   pu::PlayGround::Pointer<SampleClass> newClass = pg.AddClass<SampleClass>();
 
@@ -0,0 +1,202 @@
+#include "common/resource.hpp"
+#include "spike/master_printer.hpp"
+#include "spike/util/unit_testing.hpp"
+#include "utils/batch_read.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace pc = prime::common;
+
+namespace prime::common {
+struct EvictDeleted;
+struct EvictKept;
+struct MappedData;
+} // namespace prime::common
+
+CLASS_EXT(prime::common::EvictDeleted);
+REGISTER_CLASS(prime::common::EvictDeleted);
+CLASS_EXT(prime::common::EvictKept);
+REGISTER_CLASS(prime::common::EvictKept);
+CLASS_EXT(prime::common::MappedData);
+REGISTER_CLASS(prime::common::MappedData);
+
+// Above file limit set before LoadResources
+static constexpr size_t NUM_BATCHED = 600;
+static size_t NUM_PROCESSED = 0;
+static size_t NUM_DELETED = 0;
+// Simulates LinkResource called while Delete runs
+static bool RELINK_ON_DELETE = false;
+
+static void WriteFile(const std::string &path, const std::string &data) {
+  const int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  [[maybe_unused]] auto written = write(fd, data.data(), data.size());
+  close(fd);
+}
+
+template <class C>
+static std::string WriteResource(const std::string &root,
+                                 const std::string &name, char fill) {
+  std::string data(0x1000, fill);
+  std::string path = root + "/" + name + ".";
+  path.append(pc::GetClassExtension<C>());
+  WriteFile(path, data);
+  return data;
+}
+
+int main() {
+  es::print::AddPrinterFunction(es::Print);
+  char root[] = "/tmp/test_resource_XXXXXX";
+
+  if (!mkdtemp(root)) {
+    printf("Failed to create temporary folder\n");
+    return 1;
+  }
+
+  const std::string data0 = WriteResource<pc::EvictDeleted>(root, "a0", 'a');
+  WriteResource<pc::EvictDeleted>(root, "a1", 'b');
+  WriteResource<pc::EvictKept>(root, "b0", 'c');
+  const std::string batchedData =
+      WriteResource<pc::EvictKept>(root, "batched0", 'd');
+
+  for (size_t i = 1; i < NUM_BATCHED; i++) {
+    WriteResource<pc::EvictKept>(root, "batched" + std::to_string(i), 'd');
+  }
+
+  // Found by project cache scan, large enough to be mapped
+  const std::string cacheDir = std::string(root) + "/.prime/cache";
+  mkdir((std::string(root) + "/.prime").c_str(), 0755);
+  mkdir(cacheDir.c_str(), 0755);
+  const std::string mappedData(prime::utils::MAP_THRESHOLD + 0x1000, 'm');
+  const std::string mappedPath =
+      cacheDir + "/mapped." +
+      std::string(pc::GetClassExtension<pc::MappedData>());
+  WriteFile(mappedPath, mappedData);
+
+  pc::AddResourceHandle<pc::EvictDeleted>({
+      .Process = [](pc::ResourceData &) { NUM_PROCESSED++; },
+      .Delete =
+          [](pc::ResourceData &res) {
+            NUM_DELETED++;
+
+            if (RELINK_ON_DELETE) {
+              res.numRefs++;
+            }
+          },
+  });
+  pc::AddResourceHandle<pc::EvictKept>({
+      .Process = [](pc::ResourceData &) {},
+      .Delete = nullptr,
+  });
+  pc::ProjectDataFolder(std::string(root) + "/");
+
+  const auto a0 = pc::MakeHash<pc::EvictDeleted>("a0");
+  const auto a1 = pc::MakeHash<pc::EvictDeleted>("a1");
+  const auto b0 = pc::MakeHash<pc::EvictKept>("b0");
+  pc::LoadResource(a0);
+  pc::LoadResource(a1);
+  pc::LoadResource(b0);
+  TEST_EQUAL(NUM_PROCESSED, 2);
+
+  pc::SetResidencyBudget(0);
+
+  // Loaded during this frame, pinned
+  pc::TrimResources();
+  TEST_EQUAL(pc::GetResidencyStats().numEvictions, 0);
+  TEST_EQUAL(NUM_DELETED, 0);
+
+  pc::TrimResources();
+  auto stats = pc::GetResidencyStats();
+  TEST_EQUAL(stats.numEvictions, 2);
+  TEST_EQUAL(NUM_DELETED, 2);
+  // Processed without Delete handler cannot be evicted
+  TEST_EQUAL(stats.usedBytes, 0x1000);
+
+  // Read and processed again
+  pc::ResourceData &reloaded = pc::LoadResource(a0);
+  TEST_EQUAL(NUM_PROCESSED, 3);
+  TEST_CHECK(reloaded.isProcessed);
+  TEST_CHECK(std::string_view(reloaded.buffer) == data0);
+
+  // Linked while Delete runs, data must stay
+  RELINK_ON_DELETE = true;
+  pc::TrimResources();
+  pc::TrimResources();
+  TEST_EQUAL(NUM_DELETED, 3);
+  TEST_EQUAL(pc::GetResidencyStats().numEvictions, 2);
+  TEST_EQUAL(reloaded.numRefs, 1);
+  TEST_CHECK(!reloaded.isProcessed);
+  TEST_CHECK(std::string_view(reloaded.buffer) == data0);
+
+  // Processed again from kept data
+  pc::LoadResource(a0);
+  TEST_EQUAL(NUM_PROCESSED, 4);
+  TEST_CHECK(reloaded.isProcessed);
+
+  // Referenced, Delete is not called
+  pc::TrimResources();
+  pc::TrimResources();
+  TEST_EQUAL(NUM_DELETED, 3);
+
+  // Missing resource is not linked
+  pc::Pointer<pc::EvictDeleted> missing(pc::MakeHash<pc::EvictDeleted>("a2"));
+  TEST_CHECK(!pc::LinkResource(missing));
+
+  // Project cache file is mapped, not copied
+  pc::ResourceData &mapped =
+      pc::LoadResource(pc::MakeHash<pc::MappedData>("mapped"));
+  TEST_CHECK(mapped.buffer.IsMapped());
+  auto asMapped = mapped.As<pc::MappedData>();
+  TEST_CHECK(!asMapped.status);
+  TEST_CHECK(static_cast<void *>(asMapped.retVal) == mapped.buffer.data());
+  TEST_CHECK(std::string_view(mapped.buffer) == mappedData);
+  TEST_CHECK(&pc::FindResource(asMapped.retVal) == &mapped);
+
+  // Rewritten by converter, mapping keeps previous file
+  WriteFile(mappedPath + ".tmp", std::string(mappedData.size(), 'n'));
+  TEST_CHECK(!rename((mappedPath + ".tmp").c_str(), mappedPath.c_str()));
+  TEST_CHECK(std::string_view(mapped.buffer) == mappedData);
+
+  pc::FreeResource(mapped);
+  bool foundFreed = true;
+
+  try {
+    pc::FindResource(asMapped.retVal);
+  } catch (const std::out_of_range &) {
+    foundFreed = false;
+  }
+
+  TEST_CHECK(!foundFreed);
+
+  // More files than process may open, read in windows
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  const rlimit prevLimit = limit;
+  limit.rlim_cur = std::min<rlim_t>(256, limit.rlim_max);
+  TEST_CHECK(!setrlimit(RLIMIT_NOFILE, &limit));
+  std::vector<pc::ResourceHash> batchedHashes;
+
+  for (size_t i = 0; i < NUM_BATCHED; i++) {
+    batchedHashes.push_back(
+        pc::MakeHash<pc::EvictKept>("batched" + std::to_string(i)));
+  }
+
+  auto batched = pc::LoadResources(batchedHashes);
+  setrlimit(RLIMIT_NOFILE, &prevLimit);
+  TEST_EQUAL(batched.size(), NUM_BATCHED);
+
+  for (pc::ResourceData *b : batched) {
+    TEST_CHECK(std::string_view(b->buffer) == batchedData);
+  }
+
+  std::string cmd("rm -rf ");
+  cmd.append(root);
+  return system(cmd.c_str());
+}